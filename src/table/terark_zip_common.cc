@@ -4,6 +4,9 @@
 #include <terark/util/throw.hpp>
 #include <stdlib.h>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #ifdef _MSC_VER
 # include <io.h>
 #else
@@ -11,6 +14,13 @@
 # include <sys/stat.h>
 # include <fcntl.h>
 # include <cxxabi.h>
+# include <errno.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
+#if defined(ZSTD)
+# include <zstd.h>
 #endif
 
 namespace rocksdb {
@@ -45,6 +55,111 @@ AutoDeleteFile::~AutoDeleteFile() {
   }
 }
 
+#if defined(ZSTD)
+/// zstd stream on a temp file, the first rawSize bytes are not compressed,
+/// thus compression can be enabled after some data have been written
+class TempFileZstdStream : public terark::IInputStream
+                         , public terark::IOutputStream {
+  FileStream*    fp_;
+  ZSTD_CStream*  cstream_ = nullptr;
+  ZSTD_DStream*  dstream_ = nullptr;
+  valvec<byte_t> buf_;
+  ZSTD_inBuffer  input_ = { nullptr, 0, 0 };
+  uint64_t       rawSize_;
+  uint64_t       rawRemain_ = 0;
+  bool           eof_ = false;
+
+  static void CheckError(size_t ret, const char* func) {
+    if (ZSTD_isError(ret)) {
+      THROW_STD(runtime_error, "ERROR: %s = %s", func, ZSTD_getErrorName(ret));
+    }
+  }
+
+public:
+  TempFileZstdStream(FileStream* fp, uint64_t rawSize, int level)
+    : fp_(fp), rawSize_(rawSize) {
+    cstream_ = ZSTD_createCStream();
+    if (!cstream_) {
+      THROW_STD(runtime_error, "ERROR: ZSTD_createCStream() = nullptr");
+    }
+    CheckError(ZSTD_initCStream(cstream_, level), "ZSTD_initCStream()");
+    buf_.resize_no_init(ZSTD_CStreamOutSize());
+  }
+  ~TempFileZstdStream() {
+    if (cstream_) {
+      ZSTD_freeCStream(cstream_);
+    }
+    if (dstream_) {
+      ZSTD_freeDStream(dstream_);
+    }
+  }
+
+  size_t write(const void* vbuf, size_t length) override {
+    assert(nullptr != cstream_);
+    ZSTD_inBuffer in = { vbuf, length, 0 };
+    while (in.pos < in.size) {
+      ZSTD_outBuffer out = { buf_.data(), buf_.size(), 0 };
+      CheckError(ZSTD_compressStream(cstream_, &out, &in), "ZSTD_compressStream()");
+      fp_->ensureWrite(buf_.data(), out.pos);
+    }
+    return length;
+  }
+  void flush() override {
+    // frame is flushed by finish_write, flushing blocks here hurts ratio
+  }
+  void finish_write() {
+    for (;;) {
+      ZSTD_outBuffer out = { buf_.data(), buf_.size(), 0 };
+      size_t remain = ZSTD_endStream(cstream_, &out);
+      CheckError(remain, "ZSTD_endStream()");
+      fp_->ensureWrite(buf_.data(), out.pos);
+      if (0 == remain) {
+        break;
+      }
+    }
+    ZSTD_freeCStream(cstream_);
+    cstream_ = nullptr;
+  }
+  void start_read() {
+    dstream_ = ZSTD_createDStream();
+    if (!dstream_) {
+      THROW_STD(runtime_error, "ERROR: ZSTD_createDStream() = nullptr");
+    }
+    CheckError(ZSTD_initDStream(dstream_), "ZSTD_initDStream()");
+    buf_.resize_no_init(ZSTD_DStreamInSize());
+    input_ = { buf_.data(), 0, 0 };
+    rawRemain_ = rawSize_;
+  }
+
+  size_t read(void* vbuf, size_t length) override {
+    assert(nullptr != dstream_);
+    if (rawRemain_) {
+      size_t len = fp_->read(vbuf, size_t(std::min<uint64_t>(length, rawRemain_)));
+      rawRemain_ -= len;
+      return len;
+    }
+    ZSTD_outBuffer out = { vbuf, length, 0 };
+    while (0 == out.pos && length > 0) {
+      if (input_.pos == input_.size) {
+        input_.size = fp_->read(buf_.data(), buf_.size());
+        input_.pos = 0;
+        if (0 == input_.size) {
+          eof_ = true;
+          break;
+        }
+      }
+      CheckError(ZSTD_decompressStream(dstream_, &out, &input_), "ZSTD_decompressStream()");
+    }
+    return out.pos;
+  }
+  bool eof() const override {
+    return eof_;
+  }
+};
+#else
+class TempFileZstdStream {};
+#endif
+
 TempFileDeleteOnClose::~TempFileDeleteOnClose() {
   if (fp)
     this->close();
@@ -82,15 +197,113 @@ void TempFileDeleteOnClose::dopen(int fd) {
   fp.disbuf();
   writer.attach(&fp);
 }
+/// anonymous memory file without directory entry, returns false if it is
+/// not supported. if this->path ends with "XXXXXX", it is replaced by an
+/// unique name, which is not created but can be used as prefix of the
+/// other temp files
+bool TempFileDeleteOnClose::open_memory() {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  int fd = memfd_create("Terark", MFD_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  if (terark::fstring(path).endsWith("XXXXXX")) {
+    static std::atomic<size_t> seed(0);
+    char buf[64];
+    snprintf(buf, sizeof buf, "mem%d-%zd", int(getpid()), seed++);
+    path.replace(path.size() - 6, 6, buf);
+  }
+  this->dopen(fd);
+  in_memory = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/// move the memory file to this->path, which is created as open_temp() if
+/// it ends with "XXXXXX", fp & writer keep working on the moved file
+void TempFileDeleteOnClose::spill() {
+  assert(in_memory);
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  writer.flush_buffer();
+  int fd = ::fileno(fp.fp());
+  int newfd;
+  if (terark::fstring(path).endsWith("XXXXXX")) {
+    newfd = mkstemp(&path[0]);
+  }
+  else {
+    newfd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  }
+  if (newfd < 0) {
+    int err = errno;
+    THROW_STD(invalid_argument, "ERROR: spill to %s = %s"
+        , path.c_str(), strerror(err));
+  }
+  off_t size = ::lseek(fd, 0, SEEK_END);
+  std::unique_ptr<char[]> buf(new char[1 << 16]);
+  for (off_t pos = 0; pos < size; ) {
+    ssize_t len = ::pread(fd, buf.get(), size_t(std::min<off_t>(size - pos, 1 << 16)), pos);
+    if (len <= 0 || ::write(newfd, buf.get(), size_t(len)) != len) {
+      int err = errno;
+      ::close(newfd);
+      ::remove(path.c_str());
+      THROW_STD(invalid_argument, "ERROR: spill to %s = %s"
+          , path.c_str(), strerror(err));
+    }
+    pos += len;
+  }
+  // newfd is at end of file, fp continues writing there
+  ::dup2(newfd, fd);
+  ::close(newfd);
+  in_memory = false;
+#endif
+}
+/// compress data written after this call, returns false if zstd is not
+/// available
+bool TempFileDeleteOnClose::compress(int level) {
+#if defined(ZSTD)
+  assert(!zstd);
+  writer.flush_buffer();
+  zstd.reset(new TempFileZstdStream(&fp, fp.fsize(), level));
+  writer.attach(zstd.get());
+  return true;
+#else
+  (void)level;
+  return false;
+#endif
+}
 void TempFileDeleteOnClose::close() {
   assert(nullptr != fp);
+  zstd.reset();
   fp.close();
-  ::remove(path.c_str());
+  if (in_memory) {
+    in_memory = false;
+  }
+  else {
+    ::remove(path.c_str());
+  }
 }
 void TempFileDeleteOnClose::complete_write() {
   writer.flush_buffer();
+#if defined(ZSTD)
+  if (zstd) {
+    zstd->finish_write();
+    fp.rewind();
+    zstd->start_read();
+    return;
+  }
+#endif
   fp.rewind();
 }
+terark::IInputStream* TempFileDeleteOnClose::input() {
+#if defined(ZSTD)
+  if (zstd) {
+    return zstd.get();
+  }
+#endif
+  return &fp;
+}
 
 } // namespace rocksdb
 
@@ -3,6 +3,7 @@
 #include <terark/io/DataIO.hpp>
 #include <terark/io/FileStream.hpp>
 #include <terark/io/StreamBuffer.hpp>
+#include <memory>
 
 namespace rocksdb {
 
@@ -69,17 +70,26 @@ public:
   ~AutoDeleteFile();
 };
 
+class TempFileZstdStream;
+
 class TempFileDeleteOnClose {
 public:
   std::string path;
   FileStream  fp;
   NativeDataOutput<OutputBuffer> writer;
+  bool        in_memory = false;
+  std::unique_ptr<TempFileZstdStream> zstd;
   ~TempFileDeleteOnClose();
   void open_temp();
   void open();
   void dopen(int fd);
+  bool open_memory();
+  bool compress(int level);
+  void spill();
   void close();
   void complete_write();
+  // read from here after complete_write, data are decompressed if needed
+  terark::IInputStream* input();
 };
 
 } // namespace rocksdb
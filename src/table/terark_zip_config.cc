@@ -270,6 +270,27 @@ bool TerarkZipCFOptionsFromEnv(ColumnFamilyOptions& cfo) {
   MyGetXiB(tzo, smallTaskMemory);
   MyGetXiB(tzo, cacheCapacityBytes);
   MyGetInt(tzo, cacheShards, 17);
+  MyGetInt(tzo, filterBitsPerKey, 0);
+  MyGetXiB(tzo, valueCacheCapacityBytes);
+  MyGetInt(tzo, warmUpThreads, 0);
+  MyGetXiB(tzo, warmUpBudgetBytes);
+  MyGetInt(tzo, indexHugePage, 0);
+  MyGetBool(tzo, indexMlock, false);
+  MyGetBool(tzo, indexNumaReplica, false);
+  MyGetXiB(tzo, indexCacheAdaptiveBytes);
+  MyGetDouble(tzo, indexCacheAdaptiveRatio, 0.01);
+  MyGetInt(tzo, preadThreads, 0);
+  MyGetBool(tzo, lazyIterValue, false);
+  MyGetBool(tzo, useSeqColumn, false);
+  MyGetInt(tzo, indexFixedLenKeyMax, 0);
+  MyGetBool(tzo, indexUintKey, false);
+  MyGetBool(tzo, secondPassPipeline, false);
+  MyGetXiB(tzo, inMemoryBuildBytes);
+  MyGetInt(tzo, tempFileCompress, 0);
+  MyGetInt(tzo, dictReuseTables, 0);
+  MyGetInt(tzo, secondPassZipThreads, 4);
+  MyGetXiB(tzo, indexHugePageMinBytes);
+  MyGetInt(tzo, iterScanTriggerNext, 0);
 
 
   cfo.table_factory.reset(NewTerarkZipTableFactory(tzo, NewAdaptiveTableFactory()));
@@ -0,0 +1,114 @@
+// project headers
+#include "terark_zip_dict_registry.h"
+// std headers
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+// 3rd-party headers
+#include <xxhash.h>
+
+namespace rocksdb {
+
+const double TerarkZipDictRegistry::kMaxRatioDrift = 0.1;
+
+TerarkZipDictRegistry::TerarkZipDictRegistry(size_t reuseLimit)
+  : currentRatio_(0)
+  , currentUses_(0)
+  , reuseLimit_(reuseLimit)
+  , sweepSize_(kMinSweepSize) {
+}
+
+TerarkZipDictRegistry::DictPtr TerarkZipDictRegistry::AcquireForBuild() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!current_) {
+    return nullptr;
+  }
+  if (currentUses_ >= reuseLimit_) {
+    current_.reset(); // refresh by next fresh dictionary
+    return nullptr;
+  }
+  currentUses_++;
+  return current_;
+}
+
+void TerarkZipDictRegistry::ReportFresh(terark::fstring dict,
+                                        size_t rawBytes, size_t zipBytes) {
+  if (dict.empty() || rawBytes == 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  current_ = InternLocked(dict);
+  currentRatio_ = double(zipBytes) / rawBytes;
+  currentUses_ = 0;
+}
+
+void TerarkZipDictRegistry::ReportReuse(const DictPtr& dict,
+                                        size_t rawBytes, size_t zipBytes) {
+  if (rawBytes == 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (dict != current_) {
+    return; // already replaced
+  }
+  if (double(zipBytes) / rawBytes > currentRatio_ * (1 + kMaxRatioDrift)) {
+    current_.reset(); // value distribution changed
+  }
+}
+
+TerarkZipDictRegistry::DictPtr
+TerarkZipDictRegistry::Intern(terark::fstring dict) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return InternLocked(dict);
+}
+
+TerarkZipDictRegistry::DictPtr
+TerarkZipDictRegistry::Find(terark::fstring dict) {
+  uint64_t hash = XXH64(dict.data(), dict.size(), 0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  return FindLocked(dict, hash);
+}
+
+TerarkZipDictRegistry::DictPtr
+TerarkZipDictRegistry::FindLocked(terark::fstring dict, uint64_t hash) {
+  auto range = interned_.equal_range(hash);
+  for (auto iter = range.first; iter != range.second; ) {
+    DictPtr ptr = iter->second.lock();
+    if (!ptr) {
+      iter = interned_.erase(iter); // released, only this bucket is pruned
+      continue;
+    }
+    if (ptr->size() == size_t(dict.size()) &&
+        memcmp(ptr->data(), dict.data(), dict.size()) == 0) {
+      return ptr;
+    }
+    ++iter;
+  }
+  return nullptr;
+}
+
+TerarkZipDictRegistry::DictPtr
+TerarkZipDictRegistry::InternLocked(terark::fstring dict) {
+  uint64_t hash = XXH64(dict.data(), dict.size(), 0);
+  if (DictPtr ptr = FindLocked(dict, hash)) {
+    return ptr;
+  }
+  // drop entries of released dictionaries, amortized O(1) per insert
+  if (interned_.size() >= sweepSize_) {
+    for (auto iter = interned_.begin(); iter != interned_.end(); ) {
+      if (iter->second.expired()) {
+        iter = interned_.erase(iter);
+      }
+      else {
+        ++iter;
+      }
+    }
+    sweepSize_ = std::max<size_t>(interned_.size() * 2, kMinSweepSize);
+  }
+  DictPtr ptr = std::make_shared<terark::valvec<terark::byte_t> >(
+      (const terark::byte_t*)dict.data(), dict.size());
+  interned_.emplace(hash, ptr);
+  return ptr;
+}
+
+}  // namespace rocksdb
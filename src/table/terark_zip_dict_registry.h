@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef TERARK_ZIP_DICT_REGISTRY_H_
+#define TERARK_ZIP_DICT_REGISTRY_H_
+
+// std headers
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+// boost headers
+#include <boost/noncopyable.hpp>
+// terark headers
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+
+namespace rocksdb {
+
+/**
+ * value dictionaries shared by all tables of a factory
+ *
+ * builders: the dictionary built by a table is reused by the following
+ * builders, which skip sampling & dictionary building, until it has been
+ * reused reuseLimit times, or a table using it is compressed worse than
+ * the table which built it by more than kMaxRatioDrift, then the next
+ * builder builds a fresh one from its own samples
+ *
+ * readers: tables with the same dictionary bytes share one heap copy, so
+ * a reused dictionary is loaded once per process, tables on mmap use the
+ * shared copy only if one exists (e.g. the builders' current dictionary),
+ * otherwise they keep the dictionary on the mmap
+ */
+class TerarkZipDictRegistry : boost::noncopyable {
+public:
+  typedef std::shared_ptr<const terark::valvec<terark::byte_t> > DictPtr;
+
+  explicit TerarkZipDictRegistry(size_t reuseLimit);
+
+  /// returns null if the builder should build a fresh dictionary
+  DictPtr AcquireForBuild();
+  /// a table built a fresh dictionary
+  void ReportFresh(terark::fstring dict, size_t rawBytes, size_t zipBytes);
+  /// a table reused dict returned by AcquireForBuild
+  void ReportReuse(const DictPtr& dict, size_t rawBytes, size_t zipBytes);
+
+  /// the shared copy of the dictionary with same bytes
+  DictPtr Intern(terark::fstring dict);
+  /// same as Intern, but returns null instead of making a copy
+  DictPtr Find(terark::fstring dict);
+
+private:
+  DictPtr FindLocked(terark::fstring dict, uint64_t hash);
+  DictPtr InternLocked(terark::fstring dict);
+
+  static const double kMaxRatioDrift; // 0.1 means 10% worse
+  enum { kMinSweepSize = 16 };
+
+  std::mutex mutex_;
+  DictPtr current_;
+  double currentRatio_;
+  size_t currentUses_;
+  size_t reuseLimit_;
+  // key is hash of the dictionary bytes
+  std::unordered_multimap<uint64_t, std::weak_ptr<const terark::valvec<terark::byte_t> > > interned_;
+  size_t sweepSize_; // sweep expired entries when interned_ reaches it
+};
+
+}  // namespace rocksdb
+
+#endif /* TERARK_ZIP_DICT_REGISTRY_H_ */
@@ -0,0 +1,91 @@
+// project headers
+#include "terark_zip_filter.h"
+// std headers
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+// 3rdparty headers
+#define XXH_PRIVATE_API
+#include <xxhash.h>
+
+namespace rocksdb {
+
+static inline
+uint32_t BloomBlockIndex(uint64_t hash, uint32_t numBlocks) {
+  // multiply-shift of the high half instead of modulo
+  return uint32_t(((hash >> 32) * numBlocks) >> 32);
+}
+
+// probes in one block are driven by the low half, bit = top 9 bits
+struct BloomProbe {
+  uint32_t h2;
+  uint32_t delta;
+  explicit BloomProbe(uint64_t hash)
+    : h2(uint32_t(hash)), delta((h2 >> 17) | (h2 << 15)) {}
+  uint32_t NextBit() {
+    uint32_t bit = h2 >> 23;
+    h2 += delta;
+    return bit;
+  }
+};
+
+uint64_t TerarkZipBloomFilter::Hash(fstring userKey) {
+  return XXH64(userKey.data(), userKey.size(), 0);
+}
+
+void TerarkZipBloomFilter::Build(const uint64_t* hashes, size_t num,
+                                 int bitsPerKey, valvec<byte_t>* output) {
+  const size_t blockBits = kBlockBytes * 8;
+  size_t numBlocks = (num * bitsPerKey + blockBits - 1) / blockBits;
+  numBlocks = std::min<size_t>(std::max<size_t>(numBlocks, 1), UINT32_MAX);
+  // k = ln2 * bits/key is optimal for the classic bloom filter
+  uint32_t numProbes = uint32_t(std::min(std::max(int(bitsPerKey * 0.69), 1), 30));
+  output->resize_no_init(numBlocks * kBlockBytes + 8);
+  byte_t* data = output->data();
+  memset(data, 0, output->size());
+  for (size_t i = 0; i < num; ++i) {
+    uint64_t hash = hashes[i];
+    byte_t* block = data + kBlockBytes * BloomBlockIndex(hash, uint32_t(numBlocks));
+    BloomProbe probe(hash);
+    for (uint32_t j = 0; j < numProbes; ++j) {
+      uint32_t bit = probe.NextBit();
+      block[bit >> 3] |= byte_t(1) << (bit & 7);
+    }
+  }
+  uint32_t trailer[2] = { numProbes, uint32_t(numBlocks) };
+  memcpy(data + numBlocks * kBlockBytes, trailer, sizeof trailer);
+}
+
+bool TerarkZipBloomFilter::Init(fstring mem) {
+  data_ = nullptr;
+  numBlocks_ = 0;
+  numProbes_ = 0;
+  if (mem.size() < 8) {
+    return false;
+  }
+  uint32_t trailer[2];
+  memcpy(trailer, mem.data() + mem.size() - 8, sizeof trailer);
+  if (trailer[0] < 1 || trailer[0] > 30 || trailer[1] < 1 ||
+      size_t(trailer[1]) * kBlockBytes + 8 != size_t(mem.size())) {
+    return false;
+  }
+  data_ = (const byte_t*)mem.data();
+  numProbes_ = trailer[0];
+  numBlocks_ = trailer[1];
+  return true;
+}
+
+bool TerarkZipBloomFilter::MayMatch(uint64_t hash) const {
+  assert(!Empty());
+  const byte_t* block = data_ + kBlockBytes * BloomBlockIndex(hash, numBlocks_);
+  BloomProbe probe(hash);
+  for (uint32_t j = 0; j < numProbes_; ++j) {
+    uint32_t bit = probe.NextBit();
+    if (!((block[bit >> 3] >> (bit & 7)) & 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace rocksdb
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef TERARK_ZIP_FILTER_H_
+#define TERARK_ZIP_FILTER_H_
+
+// terark headers
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <terark/stdtypes.hpp>
+
+namespace rocksdb {
+
+using terark::fstring;
+using terark::valvec;
+using terark::byte_t;
+
+/**
+ * blocked bloom filter over user keys, all probes of one key are in one
+ * cache line, so a negative lookup costs at most one cache miss
+ *
+ * layout: | blocks(numBlocks * 64 bytes) | numProbes(4) | numBlocks(4) |
+ */
+class TerarkZipBloomFilter {
+public:
+  static const size_t kBlockBytes = 64;
+
+  /// 64 bits, so hash collisions do not add to the false positive rate
+  /// of tables with billions of keys
+  static uint64_t Hash(fstring userKey);
+  static void Build(const uint64_t* hashes, size_t num, int bitsPerKey,
+                    valvec<byte_t>* output);
+
+  TerarkZipBloomFilter() : data_(nullptr), numBlocks_(0), numProbes_(0) {}
+
+  /// memory must outlive this object, return false if mem is malformed
+  bool Init(fstring mem);
+  bool Empty() const { return 0 == numBlocks_; }
+  bool MayMatch(uint64_t hash) const;
+
+private:
+  const byte_t* data_;
+  uint32_t numBlocks_;
+  uint32_t numProbes_;
+};
+
+}  // namespace rocksdb
+
+#endif /* TERARK_ZIP_FILTER_H_ */
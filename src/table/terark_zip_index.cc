@@ -63,17 +63,49 @@ const TerarkIndex::Factory* TerarkIndex::GetFactory(fstring name) {
 }
 
 const TerarkIndex::Factory*
-TerarkIndex::SelectFactory(const KeyStat& ks, fstring name) {
+TerarkIndex::SelectFactory(const KeyStat& ks, const TerarkZipTableOptions& tzo) {
+  if (ks.minKeyLen == ks.maxKeyLen) {
+    size_t fixlen = ks.minKeyLen - ks.commonPrefixLen;
+    if (tzo.indexUintKey && fixlen <= 8) {
+      return GetFactory("EliasFanoUint");
+    }
+    if (tzo.indexFixedLenKeyMax > 0 && fixlen <= size_t(tzo.indexFixedLenKeyMax)) {
+      return GetFactory("FixedLenKey");
+    }
+  }
   if (ks.sumKeyLen - ks.numKeys * ks.commonPrefixLen > 0x1E0000000) { // 7.5G
     return GetFactory("SE_512_64");
   }
-  return GetFactory(name);
+  return GetFactory(tzo.indexType);
 }
 
 TerarkIndex::~TerarkIndex() {}
+
+void TerarkIndex::FindBatch(size_t num, const fstring* keys, size_t* recIds)
+const {
+  for (size_t i = 0; i < num; ++i) {
+    if (i > 0 && keys[i] == keys[i - 1]) {
+      recIds[i] = recIds[i - 1]; // duplicate key in sorted batch
+    }
+    else {
+      recIds[i] = Find(keys[i]);
+    }
+  }
+}
+
 TerarkIndex::Factory::~Factory() {}
 TerarkIndex::Iterator::~Iterator() {}
 
+bool TerarkIndex::Iterator::SeekMaxLE(fstring target) {
+  if (!Seek(target)) {
+    return SeekToLast(); // target is greater than all keys
+  }
+  if (key() == target) {
+    return true;
+  }
+  return Prev();
+}
+
 class NestLoudsTrieIterBase : public TerarkIndex::Iterator {
 protected:
   unique_ptr<terark::ADFA_LexIterator> m_iter;
@@ -163,7 +195,7 @@ class NestLoudsTrieIndex : public TerarkIndex {
     bool Prev() override { return Done(m_iter->decr()); }
     size_t DictRank() const override {
       assert(m_id != size_t(-1));
-      return m_id;
+      return m_dawg->state_to_dict_index(m_iter->word_state());
     }
   };
 public:
@@ -380,6 +412,616 @@ TerarkIndexRegister(TerocksIndex_NestLoudsTrieDAWG_Mixed_SE_512, "NestLoudsTrieD
 TerarkIndexRegister(TerocksIndex_NestLoudsTrieDAWG_Mixed_IL_256, "NestLoudsTrieDAWG_Mixed_IL_256", "Mixed_IL_256");
 TerarkIndexRegister(TerocksIndex_NestLoudsTrieDAWG_Mixed_XL_256, "NestLoudsTrieDAWG_Mixed_XL_256", "Mixed_XL_256");
 
+/**
+ * keys of the same length (after common prefix) in a sorted array:
+ * recId is the position, so no reorder is needed, Find is a lower bound
+ * search guided by interpolation on the leading 8 bytes, which converges
+ * in a few probes for uniformly distributed keys such as uuid
+ *
+ * | FixedLenKeyIndexHeader | numKeys * keyLen bytes | pad to 8 |
+ */
+class FixedLenKeyIndex : public TerarkIndex {
+  struct FixedLenKeyIndexHeader {
+    TerarkIndexHeader base;
+    uint64_t keyLen;
+    uint64_t numKeys;
+  };
+  const FixedLenKeyIndexHeader* m_header;
+  const byte_t* m_keys;
+  size_t m_keyLen;
+  size_t m_numKeys;
+  valvec<byte_t> m_data; // built in memory
+  MmapWholeFile m_mmap; // loaded by LoadFile
+
+  static uint64_t KeyPrefix64(fstring key) {
+    size_t n = std::min<size_t>(key.size(), 8);
+    if (0 == n) {
+      return 0;
+    }
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; ++i) {
+      x = x << 8 | byte_t(key[i]);
+    }
+    return x << (8 * (8 - n));
+  }
+  fstring KeyAt(size_t i) const {
+    assert(i < m_numKeys);
+    return fstring(m_keys + i * m_keyLen, m_keyLen);
+  }
+  /// first position whose key >= target
+  size_t LowerBound(fstring target) const {
+    size_t lo = 0, hi = m_numKeys;
+    uint64_t k = KeyPrefix64(target);
+    for (size_t round = 0; round < 4 && hi - lo > 64; ++round) {
+      uint64_t lk = KeyPrefix64(KeyAt(lo));
+      uint64_t hk = KeyPrefix64(KeyAt(hi - 1));
+      if (k < lk || k > hk || lk == hk) {
+        break; // out of range or prefix is not selective
+      }
+      size_t pos = lo + size_t((long double)(k - lk) / (hk - lk) * (hi - 1 - lo));
+      assert(pos >= lo && pos < hi);
+      if (KeyAt(pos) < target)
+        lo = pos + 1;
+      else
+        hi = pos;
+    }
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (KeyAt(mid) < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+  void Init(fstring mem) {
+    auto header = (const FixedLenKeyIndexHeader*)mem.data();
+    if (size_t(mem.size()) < sizeof(FixedLenKeyIndexHeader) ||
+        header->base.file_size != size_t(mem.size()) ||
+        header->keyLen * header->numKeys >
+          size_t(mem.size()) - sizeof(FixedLenKeyIndexHeader)) {
+      throw std::invalid_argument("FixedLenKeyIndex: bad memory");
+    }
+    m_header = header;
+    m_keys = (const byte_t*)(header + 1);
+    m_keyLen = size_t(header->keyLen);
+    m_numKeys = size_t(header->numKeys);
+  }
+
+  class MyIterator : public TerarkIndex::Iterator {
+    const FixedLenKeyIndex* m_index;
+    bool Done(size_t id) {
+      m_id = id < m_index->m_numKeys ? id : size_t(-1);
+      return size_t(-1) != m_id;
+    }
+  public:
+    explicit MyIterator(const FixedLenKeyIndex* index) : m_index(index) {}
+    bool SeekToFirst() override { return Done(0); }
+    bool SeekToLast()  override { return Done(m_index->m_numKeys - 1); }
+    bool Seek(fstring key) override { return Done(m_index->LowerBound(key)); }
+    bool SeekMaxLE(fstring key) override {
+      size_t lb = m_index->LowerBound(key);
+      if (lb < m_index->m_numKeys && m_index->KeyAt(lb) == key) {
+        return Done(lb);
+      }
+      return Done(lb - 1); // size_t(-1) if lb == 0
+    }
+    bool Next() override { return Done(m_id + 1); }
+    bool Prev() override { return Done(m_id - 1); }
+    size_t DictRank() const override {
+      assert(m_id != size_t(-1));
+      return m_id;
+    }
+    fstring key() const override { return m_index->KeyAt(m_id); }
+  };
+
+  FixedLenKeyIndex() {}
+
+public:
+  explicit FixedLenKeyIndex(fstring mem) {
+    Init(mem);
+  }
+  explicit FixedLenKeyIndex(valvec<byte_t>&& data) : m_data(std::move(data)) {
+    Init(fstring(m_data));
+  }
+  const char* Name() const override {
+    return m_header->base.class_name;
+  }
+  void SaveMmap(std::function<void(const void *, size_t)> write) const override {
+    write(m_header, size_t(m_header->base.file_size));
+  }
+  size_t Find(fstring key) const override final {
+    if (size_t(key.size()) != m_keyLen) {
+      return size_t(-1);
+    }
+    size_t lb = LowerBound(key);
+    if (lb < m_numKeys && memcmp(KeyAt(lb).data(), key.data(), m_keyLen) == 0) {
+      return lb;
+    }
+    return size_t(-1);
+  }
+  void FindBatch(size_t num, const fstring* keys, size_t* recIds)
+  const override final {
+    // gallop from the lower bound of the previous key, the distance
+    // between adjacent keys of a batch is usually much less than numKeys
+    size_t lo = 0;
+    for (size_t i = 0; i < num; ++i) {
+      fstring key = keys[i];
+      assert(i == 0 || !(key < keys[i - 1]));
+      recIds[i] = size_t(-1);
+      if (size_t(key.size()) != m_keyLen) {
+        continue;
+      }
+      size_t hi = lo;
+      for (size_t step = 1; hi < m_numKeys && KeyAt(hi) < key; step *= 2) {
+        lo = hi + 1;
+        hi += step;
+      }
+      hi = std::min(hi, m_numKeys);
+      while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (KeyAt(mid) < key)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo < m_numKeys && KeyAt(lo) == key) {
+        recIds[i] = lo;
+      }
+    }
+  }
+  size_t NumKeys() const override final {
+    return m_numKeys;
+  }
+  size_t TotalKeySize() const override final {
+    return m_numKeys * m_keyLen;
+  }
+  fstring Memory() const override final {
+    return fstring((const char*)m_header, size_t(m_header->base.file_size));
+  }
+  Iterator* NewIterator() const override final {
+    return new MyIterator(this);
+  }
+  bool NeedsReorder() const override final { return false; }
+  void GetOrderMap(UintVecMin0& newToOld)
+  const override final {
+    for (size_t i = 0; i < m_numKeys; ++i) {
+      newToOld.set_wire(i, i);
+    }
+  }
+  void BuildCache(double cacheRatio) {
+    // a plain sorted array has nothing to cache
+  }
+  class MyFactory : public Factory {
+  public:
+    TerarkIndex* Build(NativeDataInput<InputBuffer>& reader,
+                       const TerarkZipTableOptions& tzopt,
+                       const KeyStat& ks) const override {
+      assert(ks.minKeyLen == ks.maxKeyLen);
+      size_t numKeys = ks.numKeys;
+      size_t commonPrefixLen = ks.commonPrefixLen;
+      size_t fixlen = ks.minKeyLen - commonPrefixLen;
+      size_t fileSize = terark::align_up(
+        sizeof(FixedLenKeyIndexHeader) + fixlen * numKeys, 8);
+      valvec<byte_t> data;
+      data.resize(fileSize, 0);
+      auto header = (FixedLenKeyIndexHeader*)data.data();
+      static const char magic[] = "FixedLenKeyIndex";
+      header->base.magic_len = sizeof(magic) - 1;
+      memcpy(header->base.magic, magic, sizeof(magic) - 1);
+      strcpy(header->base.class_name, "FixedLenKeyIndex");
+      header->base.header_size = sizeof(FixedLenKeyIndexHeader);
+      header->base.version = 1;
+      header->base.file_size = fileSize;
+      header->keyLen = fixlen;
+      header->numKeys = numKeys;
+      byte_t* keys = data.data() + sizeof(FixedLenKeyIndexHeader);
+      bool ascending = ks.minKey < ks.maxKey;
+      valvec<byte_t> keyBuf;
+      for (size_t i = 0; i < numKeys; ++i) {
+        reader >> keyBuf;
+        assert(keyBuf.size() == ks.minKeyLen);
+        size_t pos = ascending ? i : numKeys - 1 - i;
+        memcpy(keys + pos * fixlen, keyBuf.data() + commonPrefixLen, fixlen);
+      }
+#if !defined(NDEBUG)
+      for (size_t i = 1; i < numKeys; ++i) {
+        assert(memcmp(keys + (i - 1) * fixlen, keys + i * fixlen, fixlen) < 0);
+      }
+#endif
+      return new FixedLenKeyIndex(std::move(data));
+    }
+    unique_ptr<TerarkIndex> LoadMemory(fstring mem) const override {
+      return unique_ptr<TerarkIndex>(new FixedLenKeyIndex(mem));
+    }
+    unique_ptr<TerarkIndex> LoadFile(fstring fpath) const override {
+      unique_ptr<FixedLenKeyIndex> index(new FixedLenKeyIndex());
+      MmapWholeFile(fpath).swap(index->m_mmap);
+      index->Init(index->m_mmap.memory());
+      return unique_ptr<TerarkIndex>(index.release());
+    }
+    size_t MemSizeForBuild(const KeyStat& ks) const override {
+      size_t sumRealKeyLen = ks.sumKeyLen - ks.commonPrefixLen * ks.numKeys;
+      return sizeof(FixedLenKeyIndexHeader) + sumRealKeyLen;
+    }
+  };
+};
+TerarkIndexRegister(FixedLenKeyIndex, "FixedLenKey");
+
+/**
+ * keys of the same length (after common prefix) not longer than 8 bytes,
+ * such as byte swapped uint64 keys, are big endian integers, the index is
+ * the Elias-Fano encoding of the sorted integers:
+ *
+ *   value[i] - minVal = high[i] << lowBits | low[i]
+ *   low[i]  : lowBits bits in a packed array
+ *   high[i] : one bit at position high[i] + i in the high bit vector
+ *
+ * recId is the position, select1 & select0 are sampled every 64 bits,
+ * so Find reads a sample, a bucket in the high bits and its low bits,
+ * size is about 2 + log2(range / numKeys) bits per key
+ */
+class EliasFanoUintIndex : public TerarkIndex {
+  struct EliasFanoHeader {
+    TerarkIndexHeader base;
+    uint64_t keyLen;
+    uint64_t numKeys;
+    uint64_t minVal;
+    uint64_t maxDelta; // value[numKeys-1] - minVal
+    uint64_t lowBits;
+    uint64_t highLen;  // bits of high bit vector
+    uint64_t lowWords;
+    uint64_t highWords;
+    uint64_t select1Num;
+    uint64_t select0Num;
+  };
+  enum { kSampleRate = 64 };
+  const EliasFanoHeader* m_header;
+  const uint64_t* m_low;
+  const uint64_t* m_high;
+  const uint64_t* m_select1; // position of one # i * kSampleRate
+  const uint64_t* m_select0; // position of zero # i * kSampleRate
+  size_t m_keyLen;
+  size_t m_numKeys;
+  uint64_t m_minVal;
+  uint64_t m_maxDelta;
+  size_t m_lowBits;
+  valvec<byte_t> m_data; // built in memory
+  MmapWholeFile m_mmap; // loaded by LoadFile
+
+  static size_t SelectInWord(uint64_t word, size_t r) {
+    for (size_t i = 0; i < r; ++i) {
+      word &= word - 1;
+    }
+    return __builtin_ctzll(word);
+  }
+  /// position of the r-th (from 0) set bit at or after pos in words,
+  /// flip inverts the words to select zero bits
+  static size_t SelectFrom(const uint64_t* words, size_t pos, size_t r,
+                           uint64_t flip) {
+    size_t w = pos / 64;
+    uint64_t word = (words[w] ^ flip) & (~uint64_t(0) << (pos % 64));
+    for (;;) {
+      size_t c = __builtin_popcountll(word);
+      if (r < c) {
+        return w * 64 + SelectInWord(word, r);
+      }
+      r -= c;
+      word = words[++w] ^ flip;
+    }
+  }
+  size_t Select1(size_t i) const {
+    size_t k = i / kSampleRate;
+    return SelectFrom(m_high, size_t(m_select1[k]), i - k * kSampleRate, 0);
+  }
+  size_t Select0(size_t i) const {
+    size_t k = i / kSampleRate;
+    return SelectFrom(m_high, size_t(m_select0[k]), i - k * kSampleRate,
+                      ~uint64_t(0));
+  }
+  bool HighBit(size_t pos) const {
+    return (m_high[pos / 64] >> (pos % 64)) & 1;
+  }
+  uint64_t LowAt(size_t i) const {
+    if (0 == m_lowBits) {
+      return 0;
+    }
+    size_t pos = i * m_lowBits;
+    size_t w = pos / 64, off = pos % 64;
+    uint64_t x = m_low[w] >> off;
+    if (off + m_lowBits > 64) {
+      x |= m_low[w + 1] << (64 - off);
+    }
+    return x & ((uint64_t(1) << m_lowBits) - 1);
+  }
+  uint64_t ValueAt(size_t i) const {
+    assert(i < m_numKeys);
+    uint64_t high = Select1(i) - i;
+    return m_minVal + (high << m_lowBits | LowAt(i));
+  }
+  /// big endian integer of the first min(len, keyLen) bytes, padded by 0
+  uint64_t KeyToValue(fstring key) const {
+    uint64_t x = 0;
+    for (size_t i = 0; i < m_keyLen; ++i) {
+      x = x << 8 | (i < size_t(key.size()) ? byte_t(key[i]) : 0);
+    }
+    return x;
+  }
+  void ValueToKey(uint64_t val, byte_t* buf) const {
+    for (size_t i = m_keyLen; i > 0; ) {
+      buf[--i] = byte_t(val);
+      val >>= 8;
+    }
+  }
+  /// first position whose value >= val
+  size_t LowerBoundValue(uint64_t val) const {
+    if (val <= m_minVal) {
+      return 0;
+    }
+    uint64_t delta = val - m_minVal;
+    if (delta > m_maxDelta) {
+      return m_numKeys;
+    }
+    size_t high = size_t(delta >> m_lowBits);
+    // bucket of high begins after zero # high - 1
+    size_t pos = 0 == high ? 0 : Select0(high - 1) + 1;
+    size_t idx = pos - high;
+    while (HighBit(pos)) {
+      if ((uint64_t(high) << m_lowBits | LowAt(idx)) >= delta) {
+        return idx;
+      }
+      ++pos;
+      ++idx;
+    }
+    return idx;
+  }
+  /// first position whose key >= target in bytewise order
+  size_t LowerBound(fstring target) const {
+    uint64_t val = KeyToValue(target);
+    if (size_t(target.size()) > m_keyLen) {
+      // key equals to the leading bytes is less than target
+      uint64_t maxVal = m_keyLen == 8 ? ~uint64_t(0)
+                      : (uint64_t(1) << (8 * m_keyLen)) - 1;
+      if (val == maxVal) {
+        return m_numKeys;
+      }
+      ++val;
+    }
+    return LowerBoundValue(val);
+  }
+  void Init(fstring mem) {
+    auto header = (const EliasFanoHeader*)mem.data();
+    if (size_t(mem.size()) < sizeof(EliasFanoHeader) ||
+        header->base.file_size != size_t(mem.size()) ||
+        header->keyLen > 8 || header->lowBits >= 64 ||
+        8 * (header->lowWords + header->highWords + header->select1Num +
+             header->select0Num) > size_t(mem.size()) - sizeof(EliasFanoHeader)) {
+      throw std::invalid_argument("EliasFanoUintIndex: bad memory");
+    }
+    m_header = header;
+    m_low = (const uint64_t*)(header + 1);
+    m_high = m_low + header->lowWords;
+    m_select1 = m_high + header->highWords;
+    m_select0 = m_select1 + header->select1Num;
+    m_keyLen = size_t(header->keyLen);
+    m_numKeys = size_t(header->numKeys);
+    m_minVal = header->minVal;
+    m_maxDelta = header->maxDelta;
+    m_lowBits = size_t(header->lowBits);
+  }
+
+  class MyIterator : public TerarkIndex::Iterator {
+    const EliasFanoUintIndex* m_index;
+    size_t m_pos; // position of m_id in high bit vector
+    byte_t m_key[8];
+    bool Done(size_t id) {
+      if (id >= m_index->m_numKeys) {
+        m_id = size_t(-1);
+        return false;
+      }
+      m_id = id;
+      m_pos = m_index->Select1(id);
+      UpdateKey();
+      return true;
+    }
+    void UpdateKey() {
+      uint64_t high = m_pos - m_id;
+      uint64_t val = m_index->m_minVal + (high << m_index->m_lowBits | m_index->LowAt(m_id));
+      m_index->ValueToKey(val, m_key);
+    }
+  public:
+    explicit MyIterator(const EliasFanoUintIndex* index)
+      : m_index(index), m_pos(0) {}
+    bool SeekToFirst() override { return Done(0); }
+    bool SeekToLast()  override { return Done(m_index->m_numKeys - 1); }
+    bool Seek(fstring key) override { return Done(m_index->LowerBound(key)); }
+    bool SeekMaxLE(fstring key) override {
+      size_t lb = m_index->LowerBound(key);
+      if (lb < m_index->m_numKeys &&
+          size_t(key.size()) == m_index->m_keyLen &&
+          m_index->ValueAt(lb) == m_index->KeyToValue(key)) {
+        return Done(lb);
+      }
+      return Done(lb - 1); // size_t(-1) if lb == 0
+    }
+    bool Next() override {
+      assert(size_t(-1) != m_id);
+      if (m_id + 1 >= m_index->m_numKeys) {
+        m_id = size_t(-1);
+        return false;
+      }
+      // next one bit, skip the zeros of empty buckets
+      m_pos = SelectFrom(m_index->m_high, m_pos + 1, 0, 0);
+      m_id++;
+      UpdateKey();
+      return true;
+    }
+    bool Prev() override { return Done(m_id - 1); }
+    size_t DictRank() const override {
+      assert(m_id != size_t(-1));
+      return m_id;
+    }
+    fstring key() const override {
+      return fstring(m_key, m_index->m_keyLen);
+    }
+  };
+
+  EliasFanoUintIndex() {}
+
+public:
+  explicit EliasFanoUintIndex(fstring mem) {
+    Init(mem);
+  }
+  explicit EliasFanoUintIndex(valvec<byte_t>&& data) : m_data(std::move(data)) {
+    Init(fstring(m_data));
+  }
+  const char* Name() const override {
+    return m_header->base.class_name;
+  }
+  void SaveMmap(std::function<void(const void *, size_t)> write) const override {
+    write(m_header, size_t(m_header->base.file_size));
+  }
+  size_t Find(fstring key) const override final {
+    if (size_t(key.size()) != m_keyLen) {
+      return size_t(-1);
+    }
+    uint64_t val = KeyToValue(key);
+    size_t lb = LowerBoundValue(val);
+    if (lb < m_numKeys && ValueAt(lb) == val) {
+      return lb;
+    }
+    return size_t(-1);
+  }
+  size_t NumKeys() const override final {
+    return m_numKeys;
+  }
+  size_t TotalKeySize() const override final {
+    return m_numKeys * m_keyLen;
+  }
+  fstring Memory() const override final {
+    return fstring((const char*)m_header, size_t(m_header->base.file_size));
+  }
+  Iterator* NewIterator() const override final {
+    return new MyIterator(this);
+  }
+  bool NeedsReorder() const override final { return false; }
+  void GetOrderMap(UintVecMin0& newToOld)
+  const override final {
+    for (size_t i = 0; i < m_numKeys; ++i) {
+      newToOld.set_wire(i, i);
+    }
+  }
+  void BuildCache(double cacheRatio) {
+    // select samples are the cache
+  }
+  class MyFactory : public Factory {
+  public:
+    TerarkIndex* Build(NativeDataInput<InputBuffer>& reader,
+                       const TerarkZipTableOptions& tzopt,
+                       const KeyStat& ks) const override {
+      assert(ks.minKeyLen == ks.maxKeyLen);
+      size_t numKeys = ks.numKeys;
+      size_t commonPrefixLen = ks.commonPrefixLen;
+      size_t keyLen = ks.minKeyLen - commonPrefixLen;
+      assert(keyLen <= 8);
+      assert(numKeys > 0);
+      valvec<uint64_t> values;
+      values.resize_no_init(numKeys);
+      bool ascending = ks.minKey < ks.maxKey;
+      valvec<byte_t> keyBuf;
+      for (size_t i = 0; i < numKeys; ++i) {
+        reader >> keyBuf;
+        assert(keyBuf.size() == ks.minKeyLen);
+        uint64_t x = 0;
+        for (size_t j = 0; j < keyLen; ++j) {
+          x = x << 8 | keyBuf[commonPrefixLen + j];
+        }
+        values[ascending ? i : numKeys - 1 - i] = x;
+      }
+      uint64_t minVal = values[0];
+      uint64_t maxDelta = values[numKeys - 1] - minVal;
+      size_t lowBits = 0;
+      while (lowBits < 63 && (maxDelta / numKeys) >> lowBits > 1) {
+        ++lowBits;
+      }
+      size_t highLen = size_t(maxDelta >> lowBits) + numKeys + 1;
+      // one more word, so a select never reads past the end
+      size_t lowWords = (numKeys * lowBits + 63) / 64 + 1;
+      size_t highWords = (highLen + 63) / 64 + 1;
+      size_t zeros = highLen - numKeys;
+      size_t select1Num = (numKeys + kSampleRate - 1) / kSampleRate;
+      size_t select0Num = (zeros + kSampleRate - 1) / kSampleRate;
+      size_t fileSize = sizeof(EliasFanoHeader) +
+        8 * (lowWords + highWords + select1Num + select0Num);
+      valvec<byte_t> data;
+      data.resize(fileSize, 0);
+      auto header = (EliasFanoHeader*)data.data();
+      static const char magic[] = "EliasFanoUintIndex";
+      header->base.magic_len = sizeof(magic) - 1;
+      memcpy(header->base.magic, magic, sizeof(magic) - 1);
+      strcpy(header->base.class_name, "EliasFanoUintIndex");
+      header->base.header_size = sizeof(EliasFanoHeader);
+      header->base.version = 1;
+      header->base.file_size = fileSize;
+      header->keyLen = keyLen;
+      header->numKeys = numKeys;
+      header->minVal = minVal;
+      header->maxDelta = maxDelta;
+      header->lowBits = lowBits;
+      header->highLen = highLen;
+      header->lowWords = lowWords;
+      header->highWords = highWords;
+      header->select1Num = select1Num;
+      header->select0Num = select0Num;
+      auto low = (uint64_t*)(header + 1);
+      auto high = low + lowWords;
+      auto select1 = high + highWords;
+      auto select0 = select1 + select1Num;
+      uint64_t lowMask = lowBits ? (uint64_t(1) << lowBits) - 1 : 0;
+      for (size_t i = 0; i < numKeys; ++i) {
+        assert(i == 0 || values[i - 1] < values[i]);
+        uint64_t delta = values[i] - minVal;
+        if (lowBits) {
+          size_t pos = i * lowBits;
+          uint64_t x = delta & lowMask;
+          low[pos / 64] |= x << (pos % 64);
+          if (pos % 64 + lowBits > 64) {
+            low[pos / 64 + 1] |= x >> (64 - pos % 64);
+          }
+        }
+        size_t pos = size_t(delta >> lowBits) + i;
+        high[pos / 64] |= uint64_t(1) << (pos % 64);
+        if (i % kSampleRate == 0) {
+          select1[i / kSampleRate] = pos;
+        }
+      }
+      for (size_t pos = 0, j = 0; pos < highLen; ++pos) {
+        if (!((high[pos / 64] >> (pos % 64)) & 1)) {
+          if (j % kSampleRate == 0) {
+            select0[j / kSampleRate] = pos;
+          }
+          ++j;
+        }
+      }
+      return new EliasFanoUintIndex(std::move(data));
+    }
+    unique_ptr<TerarkIndex> LoadMemory(fstring mem) const override {
+      return unique_ptr<TerarkIndex>(new EliasFanoUintIndex(mem));
+    }
+    unique_ptr<TerarkIndex> LoadFile(fstring fpath) const override {
+      unique_ptr<EliasFanoUintIndex> index(new EliasFanoUintIndex());
+      MmapWholeFile(fpath).swap(index->m_mmap);
+      index->Init(index->m_mmap.memory());
+      return unique_ptr<TerarkIndex>(index.release());
+    }
+    size_t MemSizeForBuild(const KeyStat& ks) const override {
+      // values, then about the same for the encoded data at most
+      return ks.numKeys * 8 * 2 + sizeof(EliasFanoHeader);
+    }
+  };
+};
+TerarkIndexRegister(EliasFanoUintIndex, "EliasFanoUint");
+
 
 unique_ptr<TerarkIndex> TerarkIndex::LoadFile(fstring fpath) {
   TerarkIndex::Factory* factory = NULL;
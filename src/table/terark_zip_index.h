@@ -33,8 +33,11 @@ public:
     virtual bool SeekToFirst() = 0;
     virtual bool SeekToLast() = 0;
     virtual bool Seek(fstring target) = 0;
+    /// seek to the last key <= target in bytewise order
+    virtual bool SeekMaxLE(fstring target);
     virtual bool Next() = 0;
     virtual bool Prev() = 0;
+    /// num of keys less than current key, in bytewise order
     virtual size_t DictRank() const = 0;
     inline bool Valid() const { return size_t(-1) != m_id; }
     inline size_t id() const { return m_id; }
@@ -66,13 +69,18 @@ public:
         const char* rtti_name, Factory* factory);
   };
   static const Factory* GetFactory(fstring name);
-  static const Factory* SelectFactory(const KeyStat&, fstring name);
+  /// indexType of options, or a specialized index for fixed length keys
+  static const Factory* SelectFactory(const KeyStat&,
+                                      const TerarkZipTableOptions&);
   static unique_ptr<TerarkIndex> LoadFile(fstring fpath);
   static unique_ptr<TerarkIndex> LoadMemory(fstring mem);
   virtual ~TerarkIndex();
   virtual const char* Name() const = 0;
   virtual void SaveMmap(std::function<void(const void *, size_t)> write) const = 0;
   virtual size_t Find(fstring key) const = 0;
+  /// find a batch of keys, recIds[i] = Find(keys[i])
+  /// keys should be sorted, so a search can start from the previous one
+  virtual void FindBatch(size_t num, const fstring* keys, size_t* recIds) const;
   virtual size_t NumKeys() const = 0;
   virtual size_t TotalKeySize() const = 0;
   virtual fstring Memory() const = 0;
@@ -0,0 +1,178 @@
+// project headers
+#include "terark_zip_index_cache.h"
+#include "terark_zip_table_reader.h"
+// std headers
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <assert.h>
+
+namespace rocksdb {
+
+TerarkZipIndexCacheManager::TerarkZipIndexCacheManager(size_t budgetBytes,
+                                                       double cacheRatio)
+  : building_(nullptr)
+  , budgetBytes_(budgetBytes)
+  , usedBytes_(0)
+  , cacheRatio_(cacheRatio)
+  , stop_(false) {
+  thread_ = std::thread(&TerarkZipIndexCacheManager::ThreadProc, this);
+}
+
+TerarkZipIndexCacheManager::~TerarkZipIndexCacheManager() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    // all table readers should have been closed
+    assert(parts_.empty());
+    assert(retired_.empty());
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+void TerarkZipIndexCacheManager::Register(TerarkZipSubReader* part) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t access = part->accessCount_.load(std::memory_order_relaxed);
+  parts_[part] = Entry{access, 0, 0, 0};
+}
+
+void TerarkZipIndexCacheManager::Unregister(TerarkZipSubReader* part) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [&]{ return building_ != part; });
+  auto iter = parts_.find(part);
+  if (iter != parts_.end()) {
+    usedBytes_ -= iter->second.charge;
+    parts_.erase(iter);
+  }
+  // the evicted index is loaded from the table memory
+  retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+    [part](const Retired& x) { return x.part == part; }), retired_.end());
+}
+
+size_t TerarkZipIndexCacheManager::UsedBytes() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return usedBytes_;
+}
+
+void TerarkZipIndexCacheManager::ThreadProc() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    cond_.wait_for(lock, std::chrono::seconds(unsigned(kIntervalSeconds)));
+    if (stop_) {
+      break;
+    }
+    lock.unlock();
+    BuildOnce();
+    lock.lock();
+  }
+}
+
+void TerarkZipIndexCacheManager::EvictLocked(TerarkZipSubReader* part,
+                                             Entry& entry) {
+  // new lookups fall back to index_, running lookups hold their own pin
+  part->cachedIndex_.store(nullptr, std::memory_order_release);
+  auto index = std::atomic_exchange(&part->cachedIndexHolder_,
+                                    std::shared_ptr<const TerarkIndex>());
+  retired_.push_back(Retired{part, std::move(index)});
+  usedBytes_ -= entry.charge;
+  entry.charge = 0;
+  entry.coldRounds = 0;
+}
+
+bool TerarkZipIndexCacheManager::MakeRoomLocked(size_t charge,
+                                                uint64_t access) {
+  // a victim must be much colder than the candidate to avoid thrashing
+  std::vector<std::pair<uint64_t, TerarkZipSubReader*> > victims;
+  size_t freeBytes = budgetBytes_ - std::min(usedBytes_, budgetBytes_);
+  for (auto& kv : parts_) {
+    if (kv.second.charge && kv.second.lastDelta * 2 < access) {
+      victims.emplace_back(kv.second.lastDelta, kv.first);
+      freeBytes += kv.second.charge;
+    }
+  }
+  if (freeBytes < charge) {
+    return false;
+  }
+  std::sort(victims.begin(), victims.end());
+  for (auto& v : victims) {
+    if (usedBytes_ + charge <= budgetBytes_) {
+      break;
+    }
+    EvictLocked(v.second, parts_[v.second]);
+  }
+  return true;
+}
+
+void TerarkZipIndexCacheManager::BuildOnce() {
+  struct Candidate {
+    TerarkZipSubReader* part;
+    uint64_t access;
+  };
+  std::vector<Candidate> candidates;
+  std::vector<Retired> expired; // destroyed out of the lock
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto& kv : parts_) {
+      uint64_t curr = kv.first->accessCount_.load(std::memory_order_relaxed);
+      uint64_t delta = curr - kv.second.lastAccess;
+      kv.second.lastAccess = curr;
+      kv.second.lastDelta = delta;
+      if (kv.second.charge == 0) {
+        if (delta >= kMinHotAccess) {
+          candidates.push_back({kv.first, delta});
+        }
+      }
+      else if (delta >= kMinHotAccess) {
+        kv.second.coldRounds = 0;
+      }
+      else if (++kv.second.coldRounds >= kEvictColdRounds) {
+        EvictLocked(kv.first, kv.second);
+      }
+    }
+    expired.swap(retired_);
+  }
+  expired.clear();
+  std::sort(candidates.begin(), candidates.end(),
+    [](const Candidate& x, const Candidate& y) { return x.access > y.access; });
+  for (auto& c : candidates) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = parts_.find(c.part);
+    if (stop_ || iter == parts_.end() || iter->second.charge) {
+      continue; // closed after candidates are collected
+    }
+    fstring mem = c.part->index_->Memory();
+    size_t charge = std::max<size_t>(size_t(mem.size() * cacheRatio_), 1);
+    if (usedBytes_ + charge > budgetBytes_ && !MakeRoomLocked(charge, c.access)) {
+      continue; // a smaller index may still fit
+    }
+    usedBytes_ += charge;
+    iter->second.charge = charge;
+    iter->second.coldRounds = 0;
+    building_ = c.part;
+    lock.unlock();
+    // readers keep using index_ while the new one is being built
+    unique_ptr<TerarkIndex> index;
+    try {
+      index = TerarkIndex::LoadMemory(mem);
+      index->BuildCache(cacheRatio_);
+    }
+    catch (const std::exception&) {
+      index.reset();
+    }
+    lock.lock();
+    if (index) {
+      const TerarkIndex* raw = index.get();
+      std::atomic_store(&c.part->cachedIndexHolder_,
+                        std::shared_ptr<const TerarkIndex>(std::move(index)));
+      c.part->cachedIndex_.store(raw, std::memory_order_release);
+    } else {
+      usedBytes_ -= charge;
+      parts_[c.part].charge = 0;
+    }
+    building_ = nullptr;
+    cond_.notify_all();
+  }
+}
+
+}  // namespace rocksdb
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef TERARK_ZIP_INDEX_CACHE_H_
+#define TERARK_ZIP_INDEX_CACHE_H_
+
+// std headers
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+// boost headers
+#include <boost/noncopyable.hpp>
+
+namespace rocksdb {
+
+struct TerarkZipSubReader;
+class TerarkIndex;
+
+/**
+ * adaptive index cache shared by all table readers of a factory
+ *
+ * sub readers count their lookups, a background thread periodically picks
+ * the most accessed indexes which have no cache, builds the cache on a new
+ * index object loaded from the same memory, then publishes it to the sub
+ * reader, until the total cache size reaches the budget
+ *
+ * a cached index which is cold for kEvictColdRounds rounds, or is much
+ * colder than a candidate which does not fit the budget, is evicted and
+ * its charge is returned, point lookups and iterators pin it by shared_ptr,
+ * so it is freed when the last of them releases it
+ */
+class TerarkZipIndexCacheManager : boost::noncopyable {
+public:
+  TerarkZipIndexCacheManager(size_t budgetBytes, double cacheRatio);
+  ~TerarkZipIndexCacheManager();
+
+  void Register(TerarkZipSubReader* part);
+  /// wait if the cache of part is being built
+  void Unregister(TerarkZipSubReader* part);
+
+  size_t UsedBytes() const;
+
+private:
+  struct Entry {
+    uint64_t lastAccess;
+    uint64_t lastDelta;  // accesses in last round
+    size_t   charge;     // estimated cache memory, returned on eviction
+    unsigned coldRounds; // consecutive cold rounds while cached
+  };
+  struct Retired {
+    TerarkZipSubReader* part;
+    std::shared_ptr<const TerarkIndex> index;
+  };
+  void ThreadProc();
+  void BuildOnce();
+  void EvictLocked(TerarkZipSubReader* part, Entry& entry);
+  /// evict cached indexes colder than access until charge fits
+  bool MakeRoomLocked(size_t charge, uint64_t access);
+
+  enum {
+    kMinHotAccess = 1024, // per round
+    kIntervalSeconds = 10,
+    kEvictColdRounds = 3,
+  };
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unordered_map<TerarkZipSubReader*, Entry> parts_;
+  std::vector<Retired> retired_; // released out of the lock
+  TerarkZipSubReader* building_;
+  size_t budgetBytes_;
+  size_t usedBytes_;
+  double cacheRatio_;
+  bool stop_;
+  std::thread thread_;
+};
+
+}  // namespace rocksdb
+
+#endif /* TERARK_ZIP_INDEX_CACHE_H_ */
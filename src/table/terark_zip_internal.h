@@ -21,6 +21,7 @@
 #include <rocksdb/slice.h>
 #include <rocksdb/env.h>
 #include <rocksdb/table.h>
+#include <rocksdb/cache.h>
 // terark headers
 #include <terark/fstring.hpp>
 #include <terark/valvec.hpp>
@@ -52,6 +53,8 @@ extern const std::string kTerarkZipTableIndexBlock;
 extern const std::string kTerarkZipTableValueTypeBlock;
 extern const std::string kTerarkZipTableValueDictBlock;
 extern const std::string kTerarkZipTableOffsetBlock;
+extern const std::string kTerarkZipTableFilterBlock;
+extern const std::string kTerarkZipTableSeqBlock;
 extern const std::string kTerarkZipTableCommonPrefixBlock;
 extern const std::string kTerarkEmptyTableKey;
 
@@ -167,11 +170,48 @@ struct TerarkZipMultiOffsetInfo {
     , size_t value
     , size_t type
     , size_t commonPrefix);
-  valvec<byte_t> dump();
+  valvec<byte_t> dump() const;
   bool risk_set_memory(const void*, size_t);
   void risk_release_ownership();
 };
 
+/**
+ * sequence numbers of kValue & kDelete records indexed by recId, the records
+ * in value store have no 7 bytes seq header when this column exists
+ *
+ * frame of reference packed, one part per sub table, parts are concatenated:
+ * | partSize(8) | minSeq(8) | bits(8) | packed seqs(aligned to 8, +8 pad) |
+ */
+struct TerarkZipSeqColumn {
+  static const uint64_t kUnused = uint64_t(-1); // for kZeroSeq & kMulti
+
+  const byte_t* data_ = nullptr;
+  uint64_t minSeq_ = 0;
+  size_t bits_ = 0;
+  size_t num_ = 0;
+
+  /// append one part to output, seqs[i] == kUnused is stored as minSeq
+  static void Build(const uint64_t* seqs, size_t num, valvec<byte_t>* output);
+  /// parse the part at the beginning of mem, return bytes used, 0 if bad
+  size_t Init(fstring mem, size_t num);
+  bool Empty() const { return nullptr == data_; }
+  uint64_t get(size_t recId) const {
+    assert(recId < num_);
+    if (0 == bits_) {
+      return minSeq_;
+    }
+    size_t bitPos = recId * bits_;
+    uint64_t word;
+    memcpy(&word, data_ + bitPos / 8, 8); // little endian
+    return minSeq_ + ((word >> (bitPos % 8)) & ((uint64_t(1) << bits_) - 1));
+  }
+};
+
+class TerarkZipWarmUpPool;
+class TerarkZipIndexCacheManager;
+class TerarkZipIoPool;
+class TerarkZipDictRegistry;
+
 class TerarkZipTableFactory : public TableFactory, boost::noncopyable {
 public:
   explicit
@@ -203,12 +243,24 @@ public:
   bool IsDeleteRangeSupported() const override { return true; }
 
   LruReadonlyCache* cache() const { return cache_.get(); }
+  Cache* valueCache() const { return valueCache_.get(); }
+  TerarkZipWarmUpPool* warmUpPool() const { return warmUpPool_.get(); }
+  TerarkZipIndexCacheManager* indexCacheManager() const {
+    return indexCacheManager_.get();
+  }
+  TerarkZipIoPool* ioPool() const { return ioPool_.get(); }
+  TerarkZipDictRegistry* dictRegistry() const { return dictRegistry_.get(); }
 
 private:
   TerarkZipTableOptions table_options_;
   TableFactory* fallback_factory_;
   TableFactory* adaptive_factory_; // just for open table
   boost::intrusive_ptr<LruReadonlyCache> cache_;
+  std::shared_ptr<Cache> valueCache_; // decompressed records
+  std::unique_ptr<TerarkZipWarmUpPool> warmUpPool_;
+  std::unique_ptr<TerarkZipIndexCacheManager> indexCacheManager_;
+  std::unique_ptr<TerarkZipIoPool> ioPool_; // MultiGet & scan lookahead fetch
+  std::unique_ptr<TerarkZipDictRegistry> dictRegistry_; // see dictReuseTables
   mutable size_t nth_new_terark_table_ = 0;
   mutable size_t nth_new_fallback_table_ = 0;
 private:
@@ -0,0 +1,98 @@
+// project headers
+#include "terark_zip_io_pool.h"
+// std headers
+#include <algorithm>
+#include <atomic>
+
+namespace rocksdb {
+
+struct TerarkZipIoPool::Job {
+  std::atomic<size_t> next;
+  size_t num;
+  size_t done; // guarded by mutex
+  const std::function<void(size_t)>* fn; // valid until done == num
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+TerarkZipIoPool::TerarkZipIoPool(size_t threadNum) : stop_(false) {
+  threads_.reserve(threadNum);
+  for (size_t i = 0; i < threadNum; ++i) {
+    threads_.emplace_back(&TerarkZipIoPool::WorkerProc, this);
+  }
+}
+
+TerarkZipIoPool::~TerarkZipIoPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void TerarkZipIoPool::RunJob(Job* job) {
+  size_t finished = 0;
+  for (;;) {
+    size_t i = job->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= job->num) {
+      break;
+    }
+    (*job->fn)(i);
+    ++finished;
+  }
+  if (finished) {
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->done += finished;
+    if (job->done == job->num) {
+      job->cond.notify_all();
+    }
+  }
+}
+
+void TerarkZipIoPool::ParallelFor(size_t num,
+                                  const std::function<void(size_t)>& fn) {
+  if (num <= 1 || threads_.empty()) {
+    for (size_t i = 0; i < num; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  auto job = std::make_shared<Job>();
+  job->next = 0;
+  job->num = num;
+  job->done = 0;
+  job->fn = &fn;
+  size_t helpers = std::min(num - 1, threads_.size());
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < helpers; ++i) {
+      queue_.push_back(job);
+    }
+  }
+  cond_.notify_all();
+  RunJob(job.get());
+  // helpers started late find no task and never touch fn
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->cond.wait(lock, [&]{ return job->done == num; });
+}
+
+void TerarkZipIoPool::WorkerProc() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+    if (stop_) {
+      break;
+    }
+    std::shared_ptr<Job> job = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    RunJob(job.get());
+    job.reset();
+    lock.lock();
+  }
+}
+
+}  // namespace rocksdb
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef TERARK_ZIP_IO_POOL_H_
+#define TERARK_ZIP_IO_POOL_H_
+
+// std headers
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// boost headers
+#include <boost/noncopyable.hpp>
+
+namespace rocksdb {
+
+/**
+ * threads to overlap blocking pread of value records, used by MultiGet
+ * and the scan mode of iterators, each task goes through GetRecordAppend,
+ * so records are read by pread_record_append and fill the LruReadonlyCache
+ * as usual, the calling thread also runs the tasks, so a busy pool never
+ * blocks
+ */
+class TerarkZipIoPool : boost::noncopyable {
+public:
+  explicit TerarkZipIoPool(size_t threadNum);
+  ~TerarkZipIoPool();
+
+  /// call fn(0) ... fn(num-1) in parallel, return after all are done,
+  /// fn must not throw
+  void ParallelFor(size_t num, const std::function<void(size_t)>& fn);
+
+private:
+  struct Job;
+  void WorkerProc();
+  static void RunJob(Job* job);
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::shared_ptr<Job>> queue_;
+  std::vector<std::thread> threads_;
+  bool stop_;
+};
+
+}  // namespace rocksdb
+
+#endif /* TERARK_ZIP_IO_POOL_H_ */
@@ -11,6 +11,10 @@
 #include "terark_zip_common.h"
 #include "terark_zip_internal.h"
 #include "terark_zip_table_reader.h"
+#include "terark_zip_warmup.h"
+#include "terark_zip_index_cache.h"
+#include "terark_zip_io_pool.h"
+#include "terark_zip_dict_registry.h"
 
 // std headers
 #include <future>
@@ -67,6 +71,8 @@ const std::string kTerarkZipTableIndexBlock        = "TerarkZipTableIndexBlock";
 const std::string kTerarkZipTableValueTypeBlock    = "TerarkZipTableValueTypeBlock";
 const std::string kTerarkZipTableValueDictBlock    = "TerarkZipTableValueDictBlock";
 const std::string kTerarkZipTableOffsetBlock       = "TerarkZipTableOffsetBlock";
+const std::string kTerarkZipTableFilterBlock       = "TerarkZipTableFilterBlock";
+const std::string kTerarkZipTableSeqBlock          = "TerarkZipTableSeqBlock";
 const std::string kTerarkZipTableCommonPrefixBlock = "TerarkZipTableCommonPrefixBlock";
 const std::string kTerarkEmptyTableKey             = "ThisIsAnEmptyTable";
 
@@ -138,7 +144,7 @@ void TerarkZipMultiOffsetInfo::set(size_t i, fstring p, size_t k, size_t v, size
   offset_[i].commonPrefix = c;
 }
 
-valvec<byte_t> TerarkZipMultiOffsetInfo::dump() {
+valvec<byte_t> TerarkZipMultiOffsetInfo::dump() const {
   valvec<byte_t> ret;
   size_t size = calc_size(prefixLen_, partCount_);
   ret.resize_no_init(size);
@@ -178,6 +184,58 @@ void TerarkZipMultiOffsetInfo::risk_release_ownership() {
   prefixSet_.risk_release_ownership();
 }
 
+void TerarkZipSeqColumn::Build(const uint64_t* seqs, size_t num,
+                               valvec<byte_t>* output) {
+  uint64_t minSeq = kUnused, maxSeq = 0;
+  for (size_t i = 0; i < num; ++i) {
+    if (kUnused != seqs[i]) {
+      minSeq = std::min(minSeq, seqs[i]);
+      maxSeq = std::max(maxSeq, seqs[i]);
+    }
+  }
+  if (kUnused == minSeq) {
+    minSeq = maxSeq = 0;
+  }
+  uint64_t bits = 0;
+  while (bits < 64 && (maxSeq - minSeq) >> bits) {
+    ++bits;
+  }
+  assert(bits <= 56); // sequence number has 56 bits
+  size_t dataSize = terark::align_up((num * bits + 7) / 8, 8) + 8;
+  uint64_t header[3] = { 24 + dataSize, minSeq, bits };
+  size_t pos = output->size();
+  output->append((const byte_t*)header, sizeof header);
+  output->resize(pos + sizeof header + dataSize, 0);
+  byte_t* data = output->data() + pos + sizeof header;
+  for (size_t i = 0; i < num && bits; ++i) {
+    uint64_t delta = kUnused == seqs[i] ? 0 : seqs[i] - minSeq;
+    size_t bitPos = i * bits;
+    uint64_t word;
+    memcpy(&word, data + bitPos / 8, 8);
+    word |= delta << (bitPos % 8);
+    memcpy(data + bitPos / 8, &word, 8);
+  }
+}
+
+size_t TerarkZipSeqColumn::Init(fstring mem, size_t num) {
+  data_ = nullptr;
+  uint64_t header[3];
+  if (mem.size() < ptrdiff_t(sizeof header)) {
+    return 0;
+  }
+  memcpy(header, mem.data(), sizeof header);
+  size_t dataSize = terark::align_up((num * header[2] + 7) / 8, 8) + 8;
+  if (header[2] > 56 || header[0] != 24 + dataSize ||
+      header[0] > size_t(mem.size())) {
+    return 0;
+  }
+  data_ = (const byte_t*)mem.data() + sizeof header;
+  minSeq_ = header[1];
+  bits_ = size_t(header[2]);
+  num_ = num;
+  return size_t(header[0]);
+}
+
 class TableFactory*
   NewTerarkZipTableFactory(const TerarkZipTableOptions& tzto,
     class TableFactory* fallback) {
@@ -221,6 +279,23 @@ TerarkZipTableFactory::TerarkZipTableFactory(
         cache_.reset(LruReadonlyCache::create(
             tzto.cacheCapacityBytes, tzto.cacheShards));
     }
+    if (tzto.valueCacheCapacityBytes) {
+        valueCache_ = NewLRUCache(tzto.valueCacheCapacityBytes);
+    }
+    if (tzto.warmUpThreads > 0) {
+        warmUpPool_.reset(new TerarkZipWarmUpPool(
+            tzto.warmUpThreads, tzto.warmUpBudgetBytes));
+    }
+    if (tzto.indexCacheAdaptiveBytes) {
+        indexCacheManager_.reset(new TerarkZipIndexCacheManager(
+            tzto.indexCacheAdaptiveBytes, tzto.indexCacheAdaptiveRatio));
+    }
+    if (tzto.preadThreads > 0) {
+        ioPool_.reset(new TerarkZipIoPool(tzto.preadThreads));
+    }
+    if (tzto.dictReuseTables > 0) {
+        dictRegistry_.reset(new TerarkZipDictRegistry(tzto.dictReuseTables));
+    }
 }
 
 TerarkZipTableFactory::~TerarkZipTableFactory() {
@@ -289,6 +364,26 @@ TerarkZipTableFactory::NewTableReader(
     *table = std::move(t);
     return s;
   }
+  BlockContents offsetBC;
+  s = ReadMetaBlockAdapte(file.get(), file_size, kTerarkZipTableMagicNumber
+    , table_reader_options.ioptions, kTerarkZipTableOffsetBlock, &offsetBC);
+  if (s.ok()) {
+    TerarkZipMultiOffsetInfo offsetInfo;
+    if (offsetInfo.risk_set_memory(offsetBC.data.data(), offsetBC.data.size())) {
+      size_t partCount = offsetInfo.partCount_;
+      offsetInfo.risk_release_ownership();
+      if (partCount > 1) {
+        std::unique_ptr<TerarkZipTableMultiReader>
+          t(new TerarkZipTableMultiReader(this, table_reader_options, table_options_));
+        s = t->Open(file.release(), file_size);
+        if (s.ok()) {
+          *table = std::move(t);
+        }
+        return s;
+      }
+    }
+  }
+  // else: old SST without offset block, or single part
   std::unique_ptr<TerarkZipTableReader>
     t(new TerarkZipTableReader(this, table_reader_options, table_options_));
   s = t->Open(file.release(), file_size);
@@ -328,7 +423,7 @@ TerarkZipTableFactory::NewTableBuilder(
   if (minlevel < 0) {
     minlevel = numlevel - 1;
   }
-  size_t keyPrefixLen = 0;
+  size_t keyPrefixLen = table_options_.keyPrefixLen;
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
   if (fstring(userCmp->Name()) == "rocksdb.Uint64Comparator") {
     keyPrefixLen = 0;
@@ -412,6 +507,27 @@ ret.append(buffer, snprintf(buffer, kBufferSize, fmt "\n", value))
   M_APPEND("singleIndexMemLimit      : %.3fGB", tzto.singleIndexMemLimit / gb);
   M_APPEND("cacheCapacityBytes       : %.3fGB", tzto.cacheCapacityBytes / gb);
   M_APPEND("cacheShards              : %d", tzto.cacheShards);
+  M_APPEND("filterBitsPerKey         : %d", tzto.filterBitsPerKey);
+  M_APPEND("valueCacheCapacityBytes  : %.3fGB", tzto.valueCacheCapacityBytes / gb);
+  M_APPEND("warmUpThreads            : %d", tzto.warmUpThreads);
+  M_APPEND("warmUpBudgetBytes        : %.3fGB", tzto.warmUpBudgetBytes / gb);
+  M_APPEND("indexHugePage            : %d", tzto.indexHugePage);
+  M_APPEND("indexMlock               : %s", cvb[!!tzto.indexMlock]);
+  M_APPEND("indexNumaReplica         : %s", cvb[!!tzto.indexNumaReplica]);
+  M_APPEND("indexCacheAdaptiveBytes  : %.3fGB", tzto.indexCacheAdaptiveBytes / gb);
+  M_APPEND("indexCacheAdaptiveRatio  : %f", tzto.indexCacheAdaptiveRatio);
+  M_APPEND("preadThreads             : %d", tzto.preadThreads);
+  M_APPEND("lazyIterValue            : %s", cvb[!!tzto.lazyIterValue]);
+  M_APPEND("useSeqColumn             : %s", cvb[!!tzto.useSeqColumn]);
+  M_APPEND("indexFixedLenKeyMax      : %d", tzto.indexFixedLenKeyMax);
+  M_APPEND("indexUintKey             : %s", cvb[!!tzto.indexUintKey]);
+  M_APPEND("secondPassPipeline       : %s", cvb[!!tzto.secondPassPipeline]);
+  M_APPEND("inMemoryBuildBytes       : %.3fGB", tzto.inMemoryBuildBytes / gb);
+  M_APPEND("tempFileCompress         : %d", tzto.tempFileCompress);
+  M_APPEND("dictReuseTables          : %d", tzto.dictReuseTables);
+  M_APPEND("secondPassZipThreads     : %d", tzto.secondPassZipThreads);
+  M_APPEND("indexHugePageMinBytes    : %.3fGB", tzto.indexHugePageMinBytes / gb);
+  M_APPEND("iterScanTriggerNext      : %d", tzto.iterScanTriggerNext);
 
 #undef M_APPEND
 
@@ -88,7 +88,7 @@ struct TerarkZipTableOptions {
   // use dictZip for value when average value length >= minDictZipValueSize
   // otherwise do not use dictZip
   size_t minDictZipValueSize = 30;
-  size_t keyPrefixLen = 0; // for IndexID
+  size_t keyPrefixLen = 0; // for IndexID, SST has one part per key prefix
 
   // should be a small value, typically 0.001
   // default is to disable indexCache, because the improvement
@@ -100,9 +100,110 @@ struct TerarkZipTableOptions {
   ///  < 0: do not use pread
   /// == 0: always use pread
   ///  > 0: use pread if BlobStore avg record len > minPreadLen
+  /// pread is always used if DBOptions::allow_mmap_reads is false,
+  /// then index & dict are loaded into heap
   int    minPreadLen         = -1;
   int    cacheShards         = 17; // to reduce lock competition
   size_t cacheCapacityBytes  = 0;  // non-zero implies direct io read
+                                   // required by use_direct_reads
+
+  /// bits per user key of the point lookup bloom filter, 0 to disable,
+  /// Get/MultiGet check the filter before searching the index,
+  /// unless skip_filters is true
+  int    filterBitsPerKey    = 0;
+
+  /// capacity of the decompressed value cache shared by all table readers
+  /// of the factory, 0 to disable, ReadOptions::fill_cache is honored
+  size_t valueCacheCapacityBytes = 0;
+
+  /// threads of the background warm up pool shared by all table readers
+  /// of the factory, 0 to warm up synchronously in TableReader::Open
+  int    warmUpThreads       = 0;
+  /// max bytes queued or being warmed up by the pool at a time, ranges
+  /// exceeding it are warmed up synchronously in TableReader::Open,
+  /// 0 for no limit
+  size_t warmUpBudgetBytes   = 0;
+
+  /// copy index & value type array to huge pages on open to reduce TLB miss
+  /// 0: disable, 1: transparent huge page, 2: explicit huge page(MAP_HUGETLB)
+  /// explicit huge page falls back to transparent huge page on failure
+  int    indexHugePage       = 0;
+  bool   indexMlock          = false; // mlock the huge page copy
+  /// index & value type array smaller than this is not copied to huge pages
+  size_t indexHugePageMinBytes = 1 << 20;
+
+  /// keep one copy of index & value type array per NUMA node, lookups use
+  /// the copy on the node of calling thread, no effect on single node host,
+  /// with indexHugePage the copies are on huge pages and no other huge page
+  /// copy is made
+  bool   indexNumaReplica    = false;
+
+  /// budget of the adaptive index cache shared by all table readers of
+  /// the factory, 0 to disable, only used when indexCacheRatio is 0:
+  /// the cache is built in background for the most accessed indexes,
+  /// with indexCacheAdaptiveRatio, until the budget is used up
+  size_t indexCacheAdaptiveBytes = 0;
+  double indexCacheAdaptiveRatio = 0.01;
+
+  /// threads shared by all table readers of the factory, to fetch the
+  /// records of one MultiGet batch and the lookahead records of a scanning
+  /// iterator in parallel, by pread and the cache when values are not
+  /// mmapped, 0 to do them in the calling thread
+  int    preadThreads        = 0;
+
+  /// an iterator decodes records ahead in batch after this number of
+  /// consecutive Next calls, 0 to disable, ReadOptions::readahead_size
+  /// enables it from the first Next regardless of this option
+  int    iterScanTriggerNext = 0;
+
+  /// iterators decode a single version value on the first value() call,
+  /// for key only scans, ReadOptions::value_data_length == 0 implies it
+  bool   lazyIterValue       = false;
+
+  /// store sequence numbers of single version records in a bit packed
+  /// column instead of the value records, so Get can filter by seq and
+  /// a delete needs no decompression
+  bool   useSeqColumn        = false;
+
+  /// use a sorted fixed length key array as index instead of the trie,
+  /// when all keys have the same length after common prefix and the
+  /// length is not greater than it, 0 to disable. keys are not compressed,
+  /// suitable for short random keys such as uuid
+  int    indexFixedLenKeyMax = 0;
+
+  /// use Elias-Fano encoded integers as index when all keys have the same
+  /// length not greater than 8 bytes after common prefix, such as uint64
+  /// keys, much smaller than the trie for dense keys
+  bool   indexUintKey        = false;
+
+  /// in the 2nd pass, build value records in the calling thread and feed
+  /// them to the value compressor in another thread, output is the same
+  bool   secondPassPipeline  = false;
+
+  /// with secondPassPipeline, parts of a multi part table are zipped on
+  /// at most this number of threads with the shared dictionary, each one
+  /// is charged to softZipWorkingMemLimit, 1 to zip parts one by one
+  int    secondPassZipThreads = 4;
+
+  /// keep the temp data of key, value and index in memory files and put
+  /// the store & dict files on /dev/shm, until raw key+value size of the
+  /// table exceeds it, then move them to localTempDir, 0 to disable.
+  /// suitable for flush & small compactions
+  size_t inMemoryBuildBytes  = 0;
+
+  /// compress the 1st pass temp files of values, keys & samples by zstd
+  /// level 1 to save temp disk bandwidth, no effect without zstd
+  /// 0: disable
+  /// 1: auto, compress data after raw key+value size of the table exceeds
+  ///    64MB, small tables are kept raw because they are in page cache
+  /// 2: always
+  int    tempFileCompress    = 0;
+
+  /// builders reuse the value dictionary of a previous table of the
+  /// factory for at most this number of tables instead of building one,
+  /// a fresh dictionary is built earlier if the compression ratio gets
+  /// worse, readers share the memory of identical dictionaries, 0 to disable
+  int    dictReuseTables     = 0;
   char   reserveBytes[24]    = {};
 };
 
@@ -142,6 +243,15 @@ NewTerarkZipTableFactory(const TerarkZipTableOptions&,
 
 bool TerarkZipTablePrintCacheStat(const class TableFactory*, FILE*);
 
+/// batched TableReader::Get, status[i] is the result of get_context[i] for
+/// ikeys[i], the keys are searched in sorted order and their records are
+/// read ahead together, return false if reader is not opened by
+/// TerarkZipTableFactory, the caller should then Get the keys one by one
+bool TerarkZipTableMultiGet(class TableReader*, const struct ReadOptions&,
+                            size_t num, const class Slice* ikeys,
+                            class GetContext** get_context,
+                            class Status* status, bool skip_filters);
+
 }  // namespace rocksdb
 
 #endif /* TERARK_ZIP_TABLE_H_ */
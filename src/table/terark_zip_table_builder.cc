@@ -1,8 +1,16 @@
 // project headers
 #include "terark_zip_table_builder.h"
+#include "terark_zip_filter.h"
+#include "terark_zip_dict_registry.h"
 // std headers
 #include <future>
 #include <cfloat>
+#include <deque>
+#include <exception>
+#include <thread>
+#ifndef _MSC_VER
+# include <unistd.h>
+#endif
 // boost headers
 #include <boost/scope_exit.hpp>
 // rocksdb headers
@@ -40,6 +48,114 @@ struct PendingTask {
   long long startTime;
 };
 }
+namespace {
+/**
+ * the 2nd pass is split into 2 stages on 2 threads: the calling thread
+ * reads and builds value records (from tmp file or merging the input
+ * tables by second_pass_iter_), the consumer thread feeds them to the
+ * zip builder, records are handed over in contiguous batches, so the
+ * output is the same as the single thread one
+ */
+class ZipRecordPipeline : boost::noncopyable {
+public:
+  /// onFinish is called on the consumer thread after all records are fed
+  explicit ZipRecordPipeline(DictZipBlobStore::ZipBuilder* zbuilder,
+                             std::function<void()> onFinish = nullptr)
+    : zbuilder_(zbuilder)
+    , onFinish_(std::move(onFinish))
+    , batch_(new terark::fstrvec())
+    , stop_(false) {
+    thread_ = std::thread(&ZipRecordPipeline::ThreadProc, this);
+  }
+  ~ZipRecordPipeline() {
+    if (thread_.joinable()) {
+      Finish(false);
+    }
+  }
+  void AddRecord(fstring value) {
+    batch_->push_back(value);
+    if (batch_->strpool.size() >= kBatchBytes) {
+      Push();
+    }
+  }
+  /// flush and return without waiting, no more records can be added
+  void Close() {
+    if (!batch_->empty()) {
+      Push();
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+  }
+  /// flush and wait, rethrow the error of zip builder
+  void Finish(bool rethrow = true) {
+    if (!stop_) {
+      Close();
+    }
+    thread_.join();
+    if (error_ && rethrow) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+private:
+  enum { kBatchBytes = 4 << 20, kQueueMax = 4 };
+  void Push() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]{ return queue_.size() < kQueueMax; });
+    queue_.push_back(std::move(batch_));
+    lock.unlock();
+    cond_.notify_all();
+    batch_.reset(new terark::fstrvec());
+  }
+  void ThreadProc() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cond_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break; // stop_
+      }
+      std::unique_ptr<terark::fstrvec> batch = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      cond_.notify_all();
+      if (!error_) {
+        try {
+          for (size_t i = 0; i < batch->size(); ++i) {
+            zbuilder_->addRecord((*batch)[i]);
+          }
+        }
+        catch (...) {
+          error_ = std::current_exception(); // later records are dropped
+        }
+      }
+      lock.lock();
+    }
+    lock.unlock();
+    if (!error_ && onFinish_) {
+      try {
+        onFinish_();
+      }
+      catch (...) {
+        error_ = std::current_exception();
+      }
+    }
+  }
+
+  DictZipBlobStore::ZipBuilder* zbuilder_;
+  std::function<void()> onFinish_;
+  std::unique_ptr<terark::fstrvec> batch_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::unique_ptr<terark::fstrvec>> queue_;
+  std::exception_ptr error_;
+  bool stop_;
+  std::thread thread_;
+};
+}
+
 static std::mutex zipMutex;
 static std::condition_variable zipCond;
 static valvec<PendingTask> waitQueue;
@@ -144,11 +260,29 @@ TerarkZipTableBuilder::TerarkZipTableBuilder(const TerarkZipTableFactory* table_
 
   file_ = file;
   sampleUpperBound_ = randomGenerator_.max() * table_options_.sampleRatio;
-  tmpValueFile_.path = tzto.localTempDir + "/Terark-XXXXXX";
-  tmpValueFile_.open_temp();
+  if (tzto.inMemoryBuildBytes && !tzto.isOfflineBuild) {
+    // path of memory files is only the prefix of store & dict files
+    tmpValueFile_.path = tzto.localTempDir + "/Terark-XXXXXX";
+#ifndef _MSC_VER
+    if (access("/dev/shm", W_OK) == 0) {
+      tmpValueFile_.path = "/dev/shm/Terark-XXXXXX";
+    }
+#endif
+    inMemoryBuild_ = tmpValueFile_.open_memory();
+    indexInMemory_ = inMemoryBuild_;
+  }
+  if (!inMemoryBuild_) {
+    tmpValueFile_.path = tzto.localTempDir + "/Terark-XXXXXX";
+    tmpValueFile_.open_temp();
+  }
   tmpSampleFile_.path = tmpValueFile_.path + ".sample";
-  tmpSampleFile_.open();
+  if (!inMemoryBuild_ || !tmpSampleFile_.open_memory()) {
+    tmpSampleFile_.open();
+  }
   tmpIndexFile_.fpath = tmpValueFile_.path + ".index";
+  if (tzto.tempFileCompress >= 2) {
+    CompressTempFiles();
+  }
   if (table_options_.debugLevel == 4) {
     tmpDumpFile_.open(tmpValueFile_.path + ".dump", "wb+");
   }
@@ -163,6 +297,8 @@ TerarkZipTableBuilder::TerarkZipTableBuilder(const TerarkZipTableFactory* table_
 #if defined(MADV_DONTNEED)
       madvise(data, size, MADV_DONTNEED);
 #endif
+      // offline build zips all values into one store, so only one part
+      key_prefixLen_ = 0;
       zbuilder_.reset(this->createZipBuilder());
       zbuilder_->useSample(strDict); // take ownership of strDict
                                       //zbuilder_->finishSample(); // do not call finishSample here
@@ -247,6 +383,13 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
     assert(key.size() >= 8);
     fstring userKey(key.data(), key.size() - 8);
     assert(userKey.size() >= key_prefixLen_);
+    // filter hashes the user key before byte swap & prefix strip
+    const fstring fullUserKey = userKey;
+    auto addKeyHash = [&] {
+      if (table_options_.filterBitsPerKey > 0) {
+        keyHashes_.push_back(TerarkZipBloomFilter::Hash(fullUserKey));
+      }
+    };
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
     uint64_t u64_key;
     if (isUint64Comparator_) {
@@ -260,7 +403,12 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
       char buffer[32];
       snprintf(buffer, sizeof buffer, ".keydata.%06zd", keydataSeed_++);
       newParams->data.path = tmpValueFile_.path + buffer;
-      newParams->data.open();
+      if (!inMemoryBuild_ || !newParams->data.open_memory()) {
+        newParams->data.open();
+      }
+      if (tempCompressed_) {
+        newParams->data.compress(kTempFileZstdLevel);
+      }
       currentStat_ = &newParams->stat;
       return newParams;
     };
@@ -272,6 +420,7 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
         {
           AddPrevUserKey();
         }
+        addKeyHash();
         currentStat_->minKeyLen = std::min(userKey.size(), currentStat_->minKeyLen);
         currentStat_->maxKeyLen = std::max(userKey.size(), currentStat_->maxKeyLen);
         prevUserKey_.assign(userKey);
@@ -285,6 +434,7 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
         AddPrevUserKey(true);
         BuildIndex(*histogram_.back().build.back(), histogram_.back());
       }
+      addKeyHash();
       histogram_.emplace_back();
       auto& currentHistogram = histogram_.back();
       currentHistogram.build.emplace_back(newBuildIndex());
@@ -308,6 +458,17 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
         tmpValueFile_.writer << fstringOf(value);
       }
     }
+    if (terark_unlikely(inMemoryBuild_) &&
+        properties_.raw_key_size + properties_.raw_value_size
+          > table_options_.inMemoryBuildBytes) {
+      SpillToDisk();
+    }
+    if (terark_unlikely(!tempCompressed_) &&
+        table_options_.tempFileCompress == 1 &&
+        properties_.raw_key_size + properties_.raw_value_size
+          > kTempFileCompressAutoBytes) {
+      CompressTempFiles();
+    }
   }
   else if (value_type == kTypeRangeDeletion) {
     range_del_block_.Add(key, value);
@@ -317,6 +478,57 @@ void TerarkZipTableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TerarkZipTableBuilder::SpillToDisk() {
+  assert(inMemoryBuild_);
+  INFO(ioptions_.info_log
+    , "TerarkZipTableBuilder::Add():this=%012p:  spill in memory build to disk, raw size = %.3f GB\n"
+    , this, (properties_.raw_key_size + properties_.raw_value_size) / 1e9
+  );
+  inMemoryBuild_ = false;
+  const std::string memPath = tmpValueFile_.path;
+  tmpValueFile_.path = table_options_.localTempDir + "/Terark-XXXXXX";
+  tmpValueFile_.spill();
+  // sample file is already on disk if open_memory failed, keep its path,
+  // close() removes it
+  if (tmpSampleFile_.in_memory) {
+    tmpSampleFile_.path = tmpValueFile_.path + ".sample";
+    tmpSampleFile_.spill();
+  }
+  // key data of previous parts are being read by index build, and their
+  // sizes are limited by inMemoryBuildBytes, so just leave them in memory
+  if (!histogram_.empty()) {
+    auto& data = histogram_.back().build.back()->data;
+    if (data.in_memory) {
+      data.path = tmpValueFile_.path + data.path.substr(memPath.size());
+      data.spill();
+    }
+  }
+  std::unique_lock<std::mutex> l(indexBuildMutex_);
+  tmpIndexFile_.fpath = tmpValueFile_.path + ".index";
+  if (indexInMemory_) {
+    indexInMemory_ = false;
+    FileStream(tmpIndexFile_, "wb+").ensureWrite(indexMem_.data(), indexMem_.size());
+    valvec<byte_t>().swap(indexMem_);
+  }
+}
+
+void TerarkZipTableBuilder::CompressTempFiles() {
+  assert(!tempCompressed_);
+  tempCompressed_ = true;
+  if (!tmpValueFile_.compress(kTempFileZstdLevel)) {
+    WARN(ioptions_.info_log
+      , "TerarkZipTableBuilder:this=%012p:  tempFileCompress is ignored, built without zstd\n"
+      , this
+    );
+    return;
+  }
+  tmpSampleFile_.compress(kTempFileZstdLevel);
+  // previous key data are being read by index build, they are kept raw
+  if (!histogram_.empty()) {
+    histogram_.back().build.back()->data.compress(kTempFileZstdLevel);
+  }
+}
+
 TerarkZipTableBuilder::WaitHandle::WaitHandle() : myWorkMem(0) {
 }
 TerarkZipTableBuilder::WaitHandle::WaitHandle(size_t workMem) : myWorkMem(workMem) {
@@ -428,6 +640,19 @@ TerarkZipTableBuilder::WaitHandle TerarkZipTableBuilder::WaitForMemory(const cha
   return WaitHandle{myWorkMem};
 }
 
+// never wait, reserve only if it fits softZipWorkingMemLimit with waiters
+bool TerarkZipTableBuilder::TryReserveMemory(size_t myWorkMem,
+                                             WaitHandle* handle) {
+  std::unique_lock<std::mutex> zipLock(zipMutex);
+  if (sumWaitingMem + sumWorkingMem + myWorkMem >
+      table_options_.softZipWorkingMemLimit) {
+    return false;
+  }
+  sumWorkingMem += myWorkMem;
+  *handle = WaitHandle{myWorkMem};
+  return true;
+}
+
 Status TerarkZipTableBuilder::EmptyTableFinish() {
   INFO(ioptions_.info_log
     , "TerarkZipTableBuilder::EmptyFinish():this=%012p\n", this);
@@ -504,13 +729,13 @@ void TerarkZipTableBuilder::BuildIndex(BuildIndexParams& param, KeyValueStatus&
     auto& keyStat = param.stat;
     const TerarkIndex::Factory* factory;
     {
-      factory = TerarkIndex::SelectFactory(keyStat, table_options_.indexType);
+      factory = TerarkIndex::SelectFactory(keyStat, table_options_);
     }
     if (!factory) {
       THROW_STD(invalid_argument,
         "invalid indexType: %s", table_options_.indexType.c_str());
     }
-    NativeDataInput<InputBuffer> tempKeyFileReader(&param.data.fp);
+    NativeDataInput<InputBuffer> tempKeyFileReader(param.data.input());
     const size_t myWorkMem = factory->MemSizeForBuild(keyStat);
     auto waitHandle = WaitForMemory("nltTrie", myWorkMem);
 
@@ -529,14 +754,24 @@ void TerarkZipTableBuilder::BuildIndex(BuildIndexParams& param, KeyValueStatus&
     size_t fileSize = 0;
     {
       std::unique_lock<std::mutex> l(indexBuildMutex_);
-      FileStream writer(tmpIndexFile_, "ab+");
-      param.indexFileBegin = writer.fsize();
-      indexPtr->SaveMmap([&fileSize, &writer](const void* data, size_t size) {
-        fileSize += size;
-        writer.ensureWrite(data, size);
-      });
-      writer.flush();
-      param.indexFileEnd = writer.fsize();
+      if (indexInMemory_) {
+        param.indexFileBegin = indexMem_.size();
+        indexPtr->SaveMmap([&fileSize, this](const void* data, size_t size) {
+          fileSize += size;
+          indexMem_.append((const byte_t*)data, size);
+        });
+        param.indexFileEnd = indexMem_.size();
+      }
+      else {
+        FileStream writer(tmpIndexFile_, "ab+");
+        param.indexFileBegin = writer.fsize();
+        indexPtr->SaveMmap([&fileSize, &writer](const void* data, size_t size) {
+          fileSize += size;
+          writer.ensureWrite(data, size);
+        });
+        writer.flush();
+        param.indexFileEnd = writer.fsize();
+      }
     }
     assert(param.indexFileEnd - param.indexFileBegin == fileSize);
     assert(fileSize % 8 == 0);
@@ -625,6 +860,9 @@ void TerarkZipTableBuilder::BuildReorderMap(BuildReorderParams& params,
     return;
   }
   params.type.resize_no_init(kvs.key.m_cnt_sum);
+  if (!kvs.seq.empty()) {
+    params.seq.resize_no_init(kvs.key.m_cnt_sum);
+  }
   ZReorderMap::Builder builder(kvs.key.m_cnt_sum,
     isReverseBytewiseOrder_ ? -1 : 1, params.tmpReorderFile.fpath, "wb");
   if (isReverseBytewiseOrder_) {
@@ -643,12 +881,18 @@ void TerarkZipTableBuilder::BuildReorderMap(BuildReorderParams& params,
           size_t o = count - newToOld[n] - 1 + ho;
           builder.push_back(o);
           params.type.set0(n + hn, kvs.type[o]);
+          if (!kvs.seq.empty()) {
+            params.seq[n + hn] = kvs.seq[o];
+          }
         }
       }
       else {
         for (size_t n = 0, o = count - 1 + ho; n < count; ++n, --o) {
           builder.push_back(o);
           params.type.set0(n + hn, kvs.type[o]);
+          if (!kvs.seq.empty()) {
+            params.seq[n + hn] = kvs.seq[o];
+          }
         }
       }
       hn += count;
@@ -671,6 +915,9 @@ void TerarkZipTableBuilder::BuildReorderMap(BuildReorderParams& params,
           size_t o = newToOld[n] + h;
           builder.push_back(o);
           params.type.set0(n + h, kvs.type[o]);
+          if (!kvs.seq.empty()) {
+            params.seq[n + h] = kvs.seq[o];
+          }
         }
       }
       else {
@@ -678,6 +925,9 @@ void TerarkZipTableBuilder::BuildReorderMap(BuildReorderParams& params,
           size_t o = n + h;
           builder.push_back(o);
           params.type.set0(n + h, kvs.type[o]);
+          if (!kvs.seq.empty()) {
+            params.seq[n + h] = kvs.seq[o];
+          }
         }
       }
       h += count;
@@ -696,7 +946,7 @@ LoadSample(std::unique_ptr<DictZipBlobStore::ZipBuilder>& zbuilder) {
   auto waitHandle = WaitForMemory("dictZip", dictWorkingMemory);
 
   valvec<byte_t> sample;
-  NativeDataInput<InputBuffer> sampleInput(&tmpSampleFile_.fp);
+  NativeDataInput<InputBuffer> sampleInput(tmpSampleFile_.input());
   size_t realsampleLenSum = 0;
   {
     if (sampleLenSum_ < sampleMax) {
@@ -731,11 +981,9 @@ LoadSample(std::unique_ptr<DictZipBlobStore::ZipBuilder>& zbuilder) {
 
 Status TerarkZipTableBuilder::ZipValueToFinish() {
   DebugPrepare();
-  assert(histogram_.size() == 1);
   AutoDeleteFile tmpStoreFile{tmpValueFile_.path + ".zbs"};
   AutoDeleteFile tmpDictFile{tmpValueFile_.path + ".dict"};
-  NativeDataInput<InputBuffer> input(&tmpValueFile_.fp);
-  auto& kvs = histogram_.front();
+  NativeDataInput<InputBuffer> input(tmpValueFile_.input());
   DictZipBlobStore::ZipStat dzstat;
   long long t3, t4;
   Status s;
@@ -743,20 +991,96 @@ Status TerarkZipTableBuilder::ZipValueToFinish() {
   t3 = g_pf.now();
   {
     auto zbuilder = UniquePtrOf(createZipBuilder());
-    WaitHandle dictWaitHandle = LoadSample(zbuilder);
+    auto dictRegistry = table_factory_->dictRegistry();
+    TerarkZipDictRegistry::DictPtr reuseDict;
+    if (dictRegistry) {
+      reuseDict = dictRegistry->AcquireForBuild();
+    }
+    WaitHandle dictWaitHandle;
+    if (reuseDict) {
+      valvec<byte_t> strDict(reuseDict->data(), reuseDict->size());
+      zbuilder->useSample(strDict); // take ownership of strDict
+      tmpSampleFile_.close();
+      INFO(ioptions_.info_log
+        , "TerarkZipTableBuilder::Finish():this=%012p:  reuse dict, size = %zd\n"
+        , this, reuseDict->size()
+      );
+    }
+    else {
+      dictWaitHandle = LoadSample(zbuilder);
+    }
     {
-      zbuilder->prepare(kvs.key.m_cnt_sum , tmpStoreFile);
-
-      s = BuilderWriteValues(input, kvs, [&](fstring value) {zbuilder->addRecord(value); });
-      if (s.ok()) {
-        zbuilder->finish(DictZipBlobStore::ZipBuilder::FinishFreeDict);
+      // all parts share one dict, each part is zipped to its own store,
+      // stores of multi parts are concatenated into tmpStoreFile
+      const bool isMultiPart = histogram_.size() > 1;
+      AutoDeleteFile tmpPartFile{tmpStoreFile.fpath + ".part"};
+      if (isMultiPart && table_options_.secondPassPipeline &&
+          table_options_.secondPassZipThreads > 1) {
+        // the main zip builder only holds the dict, it zips no records
         dzstat = zbuilder->getZipStat();
+        dzstat.dictZipTime = 0;
+        dzstat.pipelineThroughBytes = 0;
+        s = ZipPartsParallel(input, zbuilder->getDictionary().memory,
+                             tmpStoreFile, dzstat);
+      }
+      else {
+        for (size_t i = 0; i < histogram_.size(); ++i) {
+          auto& kvs = histogram_[i];
+          zbuilder->prepare(kvs.key.m_cnt_sum,
+            isMultiPart ? tmpPartFile.fpath : tmpStoreFile.fpath);
+          if (table_options_.secondPassPipeline) {
+            ZipRecordPipeline pipeline(zbuilder.get());
+            s = BuilderWriteValues(input, kvs, [&](fstring value) {pipeline.AddRecord(value); });
+            pipeline.Finish();
+          }
+          else {
+            s = BuilderWriteValues(input, kvs, [&](fstring value) {zbuilder->addRecord(value); });
+          }
+          if (!s.ok()) {
+            break;
+          }
+          zbuilder->finish(i + 1 < histogram_.size()
+            ? DictZipBlobStore::ZipBuilder::FinishNone
+            : DictZipBlobStore::ZipBuilder::FinishFreeDict);
+          auto partStat = zbuilder->getZipStat();
+          if (0 == i) {
+            dzstat = partStat;
+          }
+          else {
+            dzstat.dictZipTime += partStat.dictZipTime;
+            dzstat.pipelineThroughBytes += partStat.pipelineThroughBytes;
+          }
+          if (isMultiPart) {
+            terark::MmapWholeFile partMmap(tmpPartFile.fpath);
+            FileStream writer(tmpStoreFile, "ab+");
+            kvs.valueFileBegin = writer.fsize();
+            writer.ensureWrite(partMmap.base, partMmap.size);
+            writer.flush();
+            kvs.valueFileEnd = writer.fsize();
+          }
+          else {
+            kvs.valueFileBegin = 0;
+            kvs.valueFileEnd = FileStream(tmpStoreFile, "rb").fsize();
+          }
+        }
       }
 
       t4 = g_pf.now();
       if (s.ok()) {
         auto dict = zbuilder->getDictionary().memory;
         FileStream(tmpDictFile, "wb+").ensureWrite(dict.data(), dict.size());
+        if (dictRegistry) {
+          size_t zipBytes = 0;
+          for (auto& kvs : histogram_) {
+            zipBytes += kvs.valueFileEnd - kvs.valueFileBegin;
+          }
+          if (reuseDict) {
+            dictRegistry->ReportReuse(reuseDict, properties_.raw_value_size, zipBytes);
+          }
+          else if (sampleLenSum_ > 0) { // not the placeholder sample
+            dictRegistry->ReportFresh(dict, properties_.raw_value_size, zipBytes);
+          }
+        }
       }
       zbuilder.reset();
     }
@@ -784,11 +1108,94 @@ void TerarkZipTableBuilder::DebugCleanup() {
   tmpValueFile_.close();
 }
 
+Status
+TerarkZipTableBuilder::ZipPartsParallel(NativeDataInput<InputBuffer>& input,
+  fstring dict, fstring storeFile, DictZipBlobStore::ZipStat& dzstat) {
+  // parts are read in order by the calling thread, each part is zipped by
+  // its own zip builder with a copy of the shared dict on its own thread,
+  // at most secondPassZipThreads parts are in flight, part stores are
+  // concatenated in part order, same as the single thread multi part path
+  size_t zipThreads = std::min<size_t>(table_options_.secondPassZipThreads,
+    std::max<size_t>(std::thread::hardware_concurrency(), 2));
+  // a zip builder holds the dict and its match index, estimated the same
+  // as building the dict in LoadSample
+  size_t partWorkingMem = size_t(dict.size()) * 6;
+  struct PartZip {
+    WaitHandle waitHandle; // released after zbuilder
+    std::unique_ptr<DictZipBlobStore::ZipBuilder> zbuilder;
+    std::unique_ptr<ZipRecordPipeline> pipeline; // destroyed before zbuilder
+    AutoDeleteFile file;
+  };
+  std::vector<PartZip> parts(histogram_.size());
+  size_t joined = 0;
+  auto joinPart = [&]() {
+    auto& kvs = histogram_[joined];
+    auto& part = parts[joined];
+    part.pipeline->Finish(); // rethrow the error of zip builder
+    part.pipeline.reset();
+    auto partStat = part.zbuilder->getZipStat();
+    part.zbuilder.reset();
+    part.waitHandle.Release();
+    dzstat.dictZipTime += partStat.dictZipTime;
+    dzstat.pipelineThroughBytes += partStat.pipelineThroughBytes;
+    {
+      terark::MmapWholeFile partMmap(part.file.fpath);
+      FileStream writer(storeFile, "ab+");
+      kvs.valueFileBegin = writer.fsize();
+      writer.ensureWrite(partMmap.base, partMmap.size);
+      writer.flush();
+      kvs.valueFileEnd = writer.fsize();
+    }
+    part.file.Delete();
+    joined++;
+  };
+  for (size_t i = 0; i < histogram_.size(); ++i) {
+    auto& kvs = histogram_[i];
+    auto& part = parts[i];
+    // wait only when no part is in flight, else join the oldest part until
+    // the new one fits, so in flight parts never wait for each other
+    for (;;) {
+      if (joined == i) {
+        part.waitHandle = WaitForMemory("zipPart", partWorkingMem);
+        break;
+      }
+      if (i - joined < zipThreads &&
+          TryReserveMemory(partWorkingMem, &part.waitHandle)) {
+        break;
+      }
+      joinPart();
+    }
+    part.file.fpath = storeFile.str() + ".part" + terark::lcast(i);
+    part.zbuilder.reset(createZipBuilder());
+    valvec<byte_t> strDict((const byte_t*)dict.data(), dict.size());
+    part.zbuilder->useSample(strDict); // take ownership of strDict
+    part.zbuilder->prepare(kvs.key.m_cnt_sum, part.file.fpath);
+    auto zbuilder = part.zbuilder.get();
+    part.pipeline.reset(new ZipRecordPipeline(zbuilder, [zbuilder]() {
+      zbuilder->finish(DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    }));
+    auto pipeline = part.pipeline.get();
+    Status s = BuilderWriteValues(input, kvs, [&](fstring value) {pipeline->AddRecord(value); });
+    if (!s.ok()) {
+      return s; // pipelines in flight are dropped
+    }
+    pipeline->Close();
+  }
+  while (joined < histogram_.size()) {
+    joinPart();
+  }
+  return Status::OK();
+}
+
 Status
 TerarkZipTableBuilder::BuilderWriteValues(NativeDataInput<InputBuffer>& input,
   KeyValueStatus& kvs, std::function<void(fstring)> write) {
   auto& bzvType = kvs.type;
   bzvType.resize(kvs.key.m_cnt_sum );
+  bool useSeqColumn = table_options_.useSeqColumn;
+  if (useSeqColumn) {
+    kvs.seq.resize(kvs.key.m_cnt_sum, uint64_t(TerarkZipSeqColumn::kUnused));
+  }
   if (nullptr == second_pass_iter_)
   {
     valvec<byte_t> value;
@@ -814,7 +1221,12 @@ TerarkZipTableBuilder::BuilderWriteValues(NativeDataInput<InputBuffer>& input,
             bzvType.set0(recId, size_t(ZipValueType::kDelete));
           }
           value.erase_all();
-          value.append((byte_t*)&seqNum, 7);
+          if (useSeqColumn) {
+            kvs.seq[recId] = seqNum;
+          }
+          else {
+            value.append((byte_t*)&seqNum, 7);
+          }
           input.load_add(value);
         }
       }
@@ -911,7 +1323,12 @@ TerarkZipTableBuilder::BuilderWriteValues(NativeDataInput<InputBuffer>& input,
           else {
             bzvType.set0(recId, size_t(ZipValueType::kDelete));
           }
-          value.append((byte_t*)&pikey.sequence, 7);
+          if (useSeqColumn) {
+            kvs.seq[recId] = pikey.sequence;
+          }
+          else {
+            value.append((byte_t*)&pikey.sequence, 7);
+          }
           value.append(fstringOf(curVal));
           write(value);
         }
@@ -984,6 +1401,7 @@ Status TerarkZipTableBuilder::WriteStore(fstring indexMmap, terark::BlobStore* s
   BuildReorderMap(params, kvs, indexMmap, store, t6);
   if (params.type.size() != 0) {
     params.type.swap(kvs.type);
+    params.seq.swap(kvs.seq);
     ZReorderMap reorder(params.tmpReorderFile.fpath);
     t7 = g_pf.now();
     try {
@@ -1022,7 +1440,6 @@ Status TerarkZipTableBuilder::WriteSSTFile(long long t3, long long t4
   , fstring tmpDictFile
   , const DictZipBlobStore::ZipStat& dzstat)
 {
-  assert(histogram_.size() == 1);
   terark::MmapWholeFile dictMmap;
   BlobStore::Dictionary dict;
   if (!tmpDictFile.empty()) {
@@ -1030,21 +1447,31 @@ Status TerarkZipTableBuilder::WriteSSTFile(long long t3, long long t4
     dict = BlobStore::Dictionary(fstring{(const char*)dictMmap.base,
         (ptrdiff_t)dictMmap.size});
   }
-  terark::MmapWholeFile mmapIndexFile(tmpIndexFile_.fpath);
+  terark::MmapWholeFile mmapIndexFile;
+  if (!indexInMemory_) {
+    terark::MmapWholeFile(tmpIndexFile_.fpath).swap(mmapIndexFile);
+  }
+  const fstring indexMem = indexInMemory_
+      ? fstring((const char*)indexMem_.data(), indexMem_.size())
+      : mmapIndexFile.memory();
   terark::MmapWholeFile mmapStoreFile(tmpStoreFile.c_str());
-  assert(mmapIndexFile.base != nullptr);
+  assert(indexMem.data() != nullptr);
   assert(mmapStoreFile.base != nullptr);
-  auto store = UniquePtrOf(BlobStore::load_from_user_memory(mmapStoreFile.memory(), dict));
-  auto& kvs = histogram_.front();
-  auto& bzvType = kvs.type;
+  const size_t partCount = histogram_.size();
   const size_t realsampleLenSum = dict.memory.size();
   long long rawBytes = properties_.raw_key_size + properties_.raw_value_size;
   long long t5 = g_pf.now();
   Status s;
   BlockHandle dataBlock, dictBlock, indexBlock, zvTypeBlock(0, 0), tombstoneBlock(0, 0);
-  BlockHandle commonPrefixBlock;
+  BlockHandle commonPrefixBlock, filterBlock(0, 0), seqBlock(0, 0);
+  size_t sumUserKeyLen = 0, sumUserKeyNum = 0, sumTypeMemSize = 0;
+  for (auto& kvs : histogram_) {
+    sumUserKeyLen += kvs.key.m_total_key_len;
+    sumUserKeyNum += kvs.key.m_cnt_sum;
+    sumTypeMemSize += kvs.type.mem_size();
+  }
   {
-    size_t real_size = mmapIndexFile.size + store->mem_size() + bzvType.mem_size();
+    size_t real_size = indexMem.size() + mmapStoreFile.size + sumTypeMemSize;
     size_t block_size, last_allocated_block;
     file_->writable_file()->GetPreallocationStatus(&block_size, &last_allocated_block);
     INFO(ioptions_.info_log
@@ -1053,78 +1480,128 @@ Status TerarkZipTableBuilder::WriteSSTFile(long long t3, long long t4
     );
     file_->writable_file()->SetPreallocationBlockSize(1 * 1024 * 1024 + real_size);
   }
+  // per part end offsets, relative to the begin of each block
+  valvec<size_t> valueEnd(partCount), indexEnd(partCount), typeEnd(partCount, 0);
   long long t6, t7;
   offset_ = 0;
-  s = WriteStore(mmapIndexFile.memory(), store.get(), kvs, dataBlock, t5, t6, t7);
-  if (!s.ok()) {
-    return s;
+  dataBlock.set_offset(offset_);
+  for (size_t i = 0; i < partCount; ++i) {
+    auto& kvs = histogram_[i];
+    auto store = UniquePtrOf(BlobStore::load_from_user_memory(
+      fstring((const char*)mmapStoreFile.base + kvs.valueFileBegin,
+              kvs.valueFileEnd - kvs.valueFileBegin), dict));
+    BlockHandle partBlock;
+    s = WriteStore(indexMem, store.get(), kvs, partBlock, t5, t6, t7);
+    if (!s.ok()) {
+      return s;
+    }
+    valueEnd[i] = offset_ - dataBlock.offset();
   }
+  dataBlock.set_size(offset_ - dataBlock.offset());
   properties_.data_size = dataBlock.size();
   indexBlock.set_offset(offset_);
-  indexBlock.set_size(mmapIndexFile.size);
-  if (isReverseBytewiseOrder_) {
-    for (size_t j = kvs.build.size(); j > 0; ) {
-      auto& param = *kvs.build[--j];
-      DoWriteAppend((const char*)mmapIndexFile.base + param.indexFileBegin,
-        param.indexFileEnd - param.indexFileBegin);
+  indexBlock.set_size(indexMem.size());
+  try {
+    for (size_t i = 0; i < partCount; ++i) {
+      auto& kvs = histogram_[i];
+      if (isReverseBytewiseOrder_) {
+        for (size_t j = kvs.build.size(); j > 0; ) {
+          auto& param = *kvs.build[--j];
+          DoWriteAppend(indexMem.data() + param.indexFileBegin,
+            param.indexFileEnd - param.indexFileBegin);
+        }
+      }
+      else {
+        for (auto& ptr : kvs.build) {
+          auto& param = *ptr;
+          DoWriteAppend(indexMem.data() + param.indexFileBegin,
+            param.indexFileEnd - param.indexFileBegin);
+        }
+      }
+      indexEnd[i] = offset_ - indexBlock.offset();
+    }
+    assert(offset_ == indexBlock.offset() + indexBlock.size());
+    properties_.index_size = indexBlock.size();
+    if (zeroSeqCount_ != sumUserKeyNum) {
+      assert(zeroSeqCount_ < sumUserKeyNum);
+      zvTypeBlock.set_offset(offset_);
+      for (size_t i = 0; i < partCount; ++i) {
+        auto& bzvType = histogram_[i].type;
+        DoWriteAppend(bzvType.data(), bzvType.mem_size());
+        typeEnd[i] = offset_ - zvTypeBlock.offset();
+      }
+      zvTypeBlock.set_size(offset_ - zvTypeBlock.offset());
     }
   }
-  else {
-    for (auto& ptr : kvs.build) {
-      auto& param = *ptr;
-      DoWriteAppend((const char*)mmapIndexFile.base + param.indexFileBegin,
-        param.indexFileEnd - param.indexFileBegin);
+  catch (const Status& ex) {
+    return ex;
+  }
+  if (!range_del_block_.empty()) {
+    s = WriteBlock(range_del_block_.Finish(), file_, &offset_, &tombstoneBlock);
+    if (!s.ok()) {
+      return s;
     }
   }
-  assert(offset_ == indexBlock.offset() + indexBlock.size());
-  properties_.index_size = indexBlock.size();
-  if (zeroSeqCount_ != bzvType.size()) {
-    assert(zeroSeqCount_ < bzvType.size());
-    fstring zvTypeMem(bzvType.data(), bzvType.mem_size());
-    s = WriteBlock(zvTypeMem, file_, &offset_, &zvTypeBlock);
+  range_del_block_.Reset();
+  if (table_options_.useSeqColumn && zeroSeqCount_ != sumUserKeyNum) {
+    valvec<byte_t> seqData;
+    for (size_t i = 0; i < partCount; ++i) {
+      auto& kvs = histogram_[i];
+      assert(kvs.seq.size() == kvs.key.m_cnt_sum);
+      TerarkZipSeqColumn::Build(kvs.seq.data(), kvs.seq.size(), &seqData);
+      kvs.seq.clear();
+    }
+    s = WriteBlock(seqData, file_, &offset_, &seqBlock);
     if (!s.ok()) {
       return s;
     }
   }
-  if (!range_del_block_.empty()) {
-    s = WriteBlock(range_del_block_.Finish(), file_, &offset_, &tombstoneBlock);
+  if (!keyHashes_.empty()) {
+    valvec<byte_t> filter;
+    TerarkZipBloomFilter::Build(keyHashes_.data(), keyHashes_.size(),
+      table_options_.filterBitsPerKey, &filter);
+    keyHashes_.clear();
+    s = WriteBlock(filter, file_, &offset_, &filterBlock);
     if (!s.ok()) {
       return s;
     }
   }
-  range_del_block_.Reset();
+  TerarkZipMultiOffsetInfo offsetInfo;
+  offsetInfo.Init(key_prefixLen_, partCount);
   std::string commonPrefix;
-  commonPrefix.reserve(kvs.prefix.size() + kvs.commonPrefix.size());
-  commonPrefix.append(kvs.prefix.data(), kvs.prefix.size());
-  commonPrefix.append(kvs.commonPrefix.data(), kvs.commonPrefix.size());
+  for (size_t i = 0; i < partCount; ++i) {
+    auto& kvs = histogram_[i];
+    commonPrefix.append(kvs.prefix.data(), kvs.prefix.size());
+    commonPrefix.append(kvs.commonPrefix.data(), kvs.commonPrefix.size());
+    offsetInfo.set(i,
+                   fstring(kvs.prefix.data(), kvs.prefix.size()),
+                   indexEnd[i],
+                   valueEnd[i],
+                   typeEnd[i],
+                   commonPrefix.size());
+  }
   WriteBlock(commonPrefix, file_, &offset_, &commonPrefixBlock);
   s = WriteBlock(dict.memory, file_, &offset_, &dictBlock);
   if (!s.ok()) {
     return s;
   }
-  properties_.num_data_blocks = kvs.key.m_cnt_sum;
-  TerarkZipMultiOffsetInfo offsetInfo;
-  offsetInfo.Init(0, 1);
-  offsetInfo.set(0,
-                 fstring(),
-                 indexBlock.size(),
-                 properties_.data_size,
-                 zvTypeBlock.size(),
-                 commonPrefixBlock.size());
+  properties_.num_data_blocks = sumUserKeyNum;
   WriteMetaData(offsetInfo, {
     { dict.memory.size() ? &kTerarkZipTableValueDictBlock : NULL   , dictBlock         },
     { &kTerarkZipTableIndexBlock                                   , indexBlock        },
     { !zvTypeBlock.IsNull() ? &kTerarkZipTableValueTypeBlock : NULL, zvTypeBlock       },
     { &kTerarkZipTableCommonPrefixBlock                            , commonPrefixBlock },
     { !tombstoneBlock.IsNull() ? &kRangeDelBlock : NULL            , tombstoneBlock    },
+    { !filterBlock.IsNull() ? &kTerarkZipTableFilterBlock : NULL   , filterBlock       },
+    { !seqBlock.IsNull() ? &kTerarkZipTableSeqBlock : NULL         , seqBlock          },
   });
   long long t8 = g_pf.now();
   {
     std::unique_lock<std::mutex> lock(g_sumMutex);
     g_sumKeyLen += properties_.raw_key_size;
     g_sumValueLen += properties_.raw_value_size;
-    g_sumUserKeyLen += kvs.key.m_total_key_len;
-    g_sumUserKeyNum += kvs.key.m_cnt_sum;
+    g_sumUserKeyLen += sumUserKeyLen;
+    g_sumUserKeyNum += sumUserKeyNum;
     g_sumEntryNum += properties_.num_entries;
   }
   INFO(ioptions_.info_log,
@@ -1162,7 +1639,7 @@ Status TerarkZipTableBuilder::WriteSSTFile(long long t3, long long t4
 
 , g_pf.sf(t5, t6), properties_.index_size / g_pf.uf(t5, t6) // index lex walk
 
-, g_pf.sf(t6, t7), kvs.key.m_cnt_sum * 2 / 8 / (g_pf.uf(t6, t7) + 1.0) // rebuild zvType
+, g_pf.sf(t6, t7), sumUserKeyNum * 2 / 8 / (g_pf.uf(t6, t7) + 1.0) // rebuild zvType
 
 , g_pf.sf(t7, t8), double(offset_) / g_pf.uf(t7, t8) // write SST data
 
@@ -1179,23 +1656,23 @@ Status TerarkZipTableBuilder::WriteSSTFile(long long t3, long long t4
 , double(properties_.raw_value_size) / properties_.num_entries
 , double(properties_.data_size)      / properties_.num_entries
 
-, kvs.key.m_cnt_sum
-, double(kvs.key.m_total_key_len)    / kvs.key.m_cnt_sum
-, double(properties_.index_size)     / kvs.key.m_cnt_sum
-, double(properties_.raw_value_size + seqExpandSize_ + multiValueExpandSize_) / kvs.key.m_cnt_sum
-, double(properties_.data_size)      / kvs.key.m_cnt_sum
+, sumUserKeyNum
+, double(sumUserKeyLen)              / sumUserKeyNum
+, double(properties_.index_size)     / sumUserKeyNum
+, double(properties_.raw_value_size + seqExpandSize_ + multiValueExpandSize_) / sumUserKeyNum
+, double(properties_.data_size)      / sumUserKeyNum
 
 , seqExpandSize_, multiValueExpandSize_
 
-, kvs.key.m_total_key_len / 1e9, properties_.raw_value_size / 1e9, rawBytes / 1e9
+, sumUserKeyLen / 1e9, properties_.raw_value_size / 1e9, rawBytes / 1e9
 
 , properties_.index_size / 1e9, properties_.data_size / 1e9, offset_ / 1e9
 
-, double(kvs.key.m_total_key_len) / properties_.index_size
+, double(sumUserKeyLen) / properties_.index_size
 , double(properties_.raw_value_size) / properties_.data_size
 , double(rawBytes) / offset_
 
-, properties_.index_size / double(kvs.key.m_total_key_len)
+, properties_.index_size / double(sumUserKeyLen)
 , properties_.data_size / double(properties_.raw_value_size)
 , offset_ / double(rawBytes)
 
@@ -1219,6 +1696,14 @@ Status TerarkZipTableBuilder::WriteMetaData(const TerarkZipMultiOffsetInfo& offs
       metaindexBuiler.Add(*block.first, block.second);
     }
   }
+  if (offsetInfo.partCount_ > 0) {
+    BlockHandle offsetBlock;
+    Status s = WriteBlock(offsetInfo.dump(), file_, &offset_, &offsetBlock);
+    if (!s.ok()) {
+      return s;
+    }
+    metaindexBuiler.Add(kTerarkZipTableOffsetBlock, offsetBlock);
+  }
   PropertyBlockBuilder propBlockBuilder;
   propBlockBuilder.AddTableProperty(properties_);
   UserCollectedProperties user_collected_properties;
@@ -1255,41 +1740,35 @@ Status TerarkZipTableBuilder::WriteMetaData(const TerarkZipMultiOffsetInfo& offs
 }
 
 Status TerarkZipTableBuilder::OfflineFinish() {
-  //std::unique_ptr<DictZipBlobStore> zstore(zbuilder_->finish(
-  //  DictZipBlobStore::ZipBuilder::FinishFreeDict));
-  //fstring fpath = zstore->get_fpath();
-  //std::string tmpStoreFile(fpath.data(), fpath.size());
-  //auto& kvs = histogram_[0];
-  //auto dzstat = zbuilder_->getZipStat();
-  //valvec<byte_t> commonPrefix(prevUserKey_.data(), kvs.stat.commonPrefixLen);
-  //AutoDeleteFile tmpIndexFile{tmpValueFile_.path + ".index"};
-  //AutoDeleteFile tmpDictFile{tmpValueFile_.path + ".dict"};
-  //fstring dict = zstore->get_dict().memory;
-  //FileStream(tmpDictFile, "wb+").ensureWrite(dict.data(), dict.size());
-  //zstore.reset();
-  //zbuilder_.reset();
-  //long long t1 = g_pf.now();
-  //{
-  //  auto factory = TerarkIndex::GetFactory(table_options_.indexType);
-  //  if (!factory) {
-  //    THROW_STD(invalid_argument,
-  //      "invalid indexType: %s", table_options_.indexType.c_str());
-  //  }
-  //  NativeDataInput<InputBuffer> tempKeyFileReader(&tmpKeyFile_.fp);
-  //  FileStream writer(tmpIndexFile, "wb+");
-  //  factory->Build(tempKeyFileReader, table_options_,
-  //    [&writer](const void* data, size_t size) {
-  //      writer.ensureWrite(data, size);
-  //    },
-  //    kvs.stat);
-  //}
-  //long long tt = g_pf.now();
-  //INFO(ioptions_.info_log
-  //  , "TerarkZipTableBuilder::Finish():this=%012p:  index pass time =%8.2f's,%8.3f'MB/sec\n"
-  //  , this, g_pf.sf(t1, tt), properties_.raw_key_size*1.0 / g_pf.uf(t1, tt)
-  //);
-  //return WriteSSTFile(t1, tt, tmpIndexFile, tmpStoreFile, tmpDictFile, dzstat);
-  return Status::OK();
+  // offline build has only one part, values have been zipped by Add
+  assert(histogram_.size() == 1);
+  auto& kvs = histogram_[0];
+  assert(kvs.type.size() == kvs.key.m_cnt_sum);
+  long long t3 = t0, t4;
+  DictZipBlobStore::ZipStat dzstat;
+  {
+    zbuilder_->finish(DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    dzstat = zbuilder_->getZipStat();
+    t4 = g_pf.now();
+    auto dict = zbuilder_->getDictionary().memory;
+    FileStream(tmpZipDictFile_, "wb+").ensureWrite(dict.data(), dict.size());
+    zbuilder_.reset();
+  }
+  kvs.valueFileBegin = 0;
+  kvs.valueFileEnd = FileStream(tmpZipValueFile_, "rb").fsize();
+  {
+    long long rawBytes = properties_.raw_key_size + properties_.raw_value_size;
+    INFO(ioptions_.info_log
+      , "TerarkZipTableBuilder::Finish():this=%012p:  offline pass time =%8.2f's,%8.3f'MB/sec\n"
+      , this, g_pf.sf(t3, t4), rawBytes*1.0 / g_pf.uf(t3, t4)
+    );
+  }
+  DebugCleanup();
+  Status indexBuildResult = WaitBuildIndex();
+  if (!indexBuildResult.ok()) {
+    return indexBuildResult;
+  }
+  return WriteSSTFile(t3, t4, tmpZipValueFile_, tmpZipDictFile_, dzstat);
 }
 
 void TerarkZipTableBuilder::Abandon() {
@@ -1334,12 +1813,17 @@ void TerarkZipTableBuilder::AddPrevUserKey(bool finish) {
 void TerarkZipTableBuilder::OfflineZipValueData() {
   uint64_t seq, seqType = *(uint64_t*)valueBuf_.strpool.data();
   auto& bzvType = histogram_[0].type;
+  auto& seqColumn = histogram_[0].seq;
+  bool useSeqColumn = table_options_.useSeqColumn;
   ValueType type;
   UnPackSequenceAndType(seqType, &seq, &type);
   const size_t vNum = valueBuf_.size();
   if (vNum == 1 && (kTypeDeletion == type || kTypeValue == type)) {
     if (0 == seq && kTypeValue == type) {
       bzvType.push_back(byte_t(ZipValueType::kZeroSeq));
+      if (useSeqColumn) {
+        seqColumn.push_back(uint64_t(TerarkZipSeqColumn::kUnused));
+      }
       zbuilder_->addRecord(fstring(valueBuf_.strpool).substr(8));
     }
     else {
@@ -1349,13 +1833,22 @@ void TerarkZipTableBuilder::OfflineZipValueData() {
       else {
         bzvType.push_back(byte_t(ZipValueType::kDelete));
       }
-      // use Little Endian upper 7 bytes
-      *(uint64_t*)valueBuf_.strpool.data() <<= 8;
-      zbuilder_->addRecord(fstring(valueBuf_.strpool).substr(1));
+      if (useSeqColumn) {
+        seqColumn.push_back(seq);
+        zbuilder_->addRecord(fstring(valueBuf_.strpool).substr(8));
+      }
+      else {
+        // use Little Endian upper 7 bytes
+        *(uint64_t*)valueBuf_.strpool.data() <<= 8;
+        zbuilder_->addRecord(fstring(valueBuf_.strpool).substr(1));
+      }
     }
   }
   else {
     bzvType.push_back(byte_t(ZipValueType::kMulti));
+    if (useSeqColumn) {
+      seqColumn.push_back(uint64_t(TerarkZipSeqColumn::kUnused));
+    }
     size_t valueBytes = valueBuf_.strpool.size();
     size_t headerSize = ZipValueMultiValue::calcHeaderSize(vNum);
     valueBuf_.strpool.grow_no_init(headerSize);
@@ -1382,8 +1875,13 @@ void TerarkZipTableBuilder::UpdateValueLenHistogram() {
       ++zeroSeqCount_;
     }
     else {
-      valueLen = valueBuf_.strpool.size() - 1;
-      seqExpandSize_ += 7;
+      if (table_options_.useSeqColumn) {
+        valueLen = valueBuf_.strpool.size() - 8;
+      }
+      else {
+        valueLen = valueBuf_.strpool.size() - 1;
+        seqExpandSize_ += 7;
+      }
     }
   }
   else {
@@ -88,6 +88,7 @@ private:
     Uint64Histogram key;
     Uint64Histogram value;
     bitfield_array<2> type;
+    valvec<uint64_t> seq; // empty if !useSeqColumn
     size_t split = 0;
     uint64_t indexFileBegin = 0;
     uint64_t indexFileEnd = 0;
@@ -96,6 +97,12 @@ private:
     valvec<std::unique_ptr<BuildIndexParams>> build;
   };
   void AddPrevUserKey(bool finish = false);
+  void SpillToDisk();
+  void CompressTempFiles();
+  enum {
+    kTempFileZstdLevel = 1,
+    kTempFileCompressAutoBytes = 64 << 20,
+  };
   void OfflineZipValueData();
   void UpdateValueLenHistogram();
   struct WaitHandle : boost::noncopyable {
@@ -108,6 +115,7 @@ private:
     ~WaitHandle();
   };
   WaitHandle WaitForMemory(const char* who, size_t memorySize);
+  bool TryReserveMemory(size_t memorySize, WaitHandle* handle);
   Status EmptyTableFinish();
   Status OfflineFinish();
   void BuildIndex(BuildIndexParams& param, KeyValueStatus& kvs);
@@ -115,6 +123,7 @@ private:
   struct BuildReorderParams {
     AutoDeleteFile tmpReorderFile;
     bitfield_array<2> type;
+    valvec<uint64_t> seq;
   };
   void BuildReorderMap(BuildReorderParams& params,
     KeyValueStatus& kvs,
@@ -123,6 +132,8 @@ private:
     long long& t6);
   WaitHandle LoadSample(std::unique_ptr<DictZipBlobStore::ZipBuilder>& zbuilder);
   Status ZipValueToFinish();
+  Status ZipPartsParallel(NativeDataInput<InputBuffer>& input, fstring dict
+    , fstring storeFile, DictZipBlobStore::ZipStat& dzstat);
   void DebugPrepare();
   void DebugCleanup();
   Status BuilderWriteValues(NativeDataInput<InputBuffer>& tmpValueFileinput
@@ -150,6 +161,7 @@ private:
   InternalIterator* second_pass_iter_ = nullptr;
   size_t keydataSeed_ = 0;
   valvec<KeyValueStatus> histogram_;
+  valvec<uint64_t> keyHashes_; // for filter, one hash per user key
   TerarkIndex::KeyStat *currentStat_ = nullptr;
   valvec<byte_t> prevUserKey_;
   terark::febitvec valueBits_;
@@ -158,6 +170,7 @@ private:
   TempFileDeleteOnClose tmpSampleFile_;
   AutoDeleteFile tmpIndexFile_;
   std::mutex indexBuildMutex_;
+  valvec<byte_t> indexMem_; // index of in memory build, by indexBuildMutex_
   FileStream tmpDumpFile_;
   AutoDeleteFile tmpZipDictFile_;
   AutoDeleteFile tmpZipValueFile_;
@@ -179,6 +192,9 @@ private:
   terark::fstrvec valueBuf_; // collect multiple values for one key
   bool waitInited_ = false;
   bool closed_ = false;  // Either Finish() or Abandon() has been called.
+  bool inMemoryBuild_ = false;
+  bool indexInMemory_ = false;
+  bool tempCompressed_ = false;
   bool isReverseBytewiseOrder_;
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
   bool isUint64Comparator_;
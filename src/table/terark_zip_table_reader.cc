@@ -1,6 +1,13 @@
 // project headers
 #include "terark_zip_table_reader.h"
 #include "terark_zip_common.h"
+#include "terark_zip_warmup.h"
+#include "terark_zip_index_cache.h"
+#include "terark_zip_io_pool.h"
+#include "terark_zip_dict_registry.h"
+// std headers
+#include <algorithm>
+#include <ctype.h>
 // rocksdb headers
 #include <table/internal_iterator.h>
 #include <table/sst_file_writer_collectors.h>
@@ -12,8 +19,12 @@
 
 #ifndef _MSC_VER
 # include <sys/unistd.h>
+# include <sys/mman.h>
 # include <fcntl.h>
 #endif
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
 
 namespace {
 using namespace rocksdb;
@@ -89,15 +100,7 @@ void SharedBlockCleanupFunction(void* arg1, void* arg2) {
 
 
 static void MmapWarmUpBytes(const void* addr, size_t len) {
-  auto base = (const byte_t*)(uintptr_t(addr) & uintptr_t(~4095));
-  auto size = terark::align_up((size_t(addr) & 4095) + len, 4096);
-#ifdef POSIX_MADV_WILLNEED
-  posix_madvise((void*)base, size, POSIX_MADV_WILLNEED);
-#endif
-  for (size_t i = 0; i < size; i += 4096) {
-    volatile byte_t unused = ((const volatile byte_t*)base)[i];
-    (void)unused;
-  }
+  TerarkZipWarmUpPool::WarmUpBytes(addr, len);
 }
 template<class T>
 static void MmapWarmUp(const T* addr, size_t len) {
@@ -138,6 +141,14 @@ static void MmapColdize(const Vec& uv) {
 }
 */
 
+static inline void PrefetchForRead(const void* addr) {
+#if defined(__GNUC__)
+  __builtin_prefetch(addr, 0, 3);
+#else
+  (void)addr;
+#endif
+}
+
 static void MmapAdviseRandom(const void* addr, size_t len) {
   size_t low = terark::align_up(size_t(addr), 4096);
   size_t hig = terark::align_down(size_t(addr) + len, 4096);
@@ -149,10 +160,175 @@ static void MmapAdviseRandom(const void* addr, size_t len) {
 #endif
   }
 }
+static void MmapWillNeed(const void* addr, size_t len) {
+  size_t low = terark::align_down(size_t(addr), 4096);
+  size_t hig = terark::align_up(size_t(addr) + len, 4096);
+#ifdef POSIX_MADV_WILLNEED
+  posix_madvise((void*)low, hig - low, POSIX_MADV_WILLNEED);
+#else
+  (void)low; (void)hig;
+#endif
+}
 static void MmapAdviseRandom(fstring mem) {
   MmapAdviseRandom(mem.data(), mem.size());
 }
 
+// anonymous memory with the same layout as the file, the file is not
+// mapped, pages are allocated only when they are filled by ReadToMemory
+Status AnonymousAlloc(size_t size, Slice* data) {
+#ifdef _MSC_VER
+  return Status::InvalidArgument("TerarkZipTableReader::Open()",
+    "EnvOptions::use_mmap_reads must be true");
+#else
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+# if defined(MAP_NORESERVE)
+  flags |= MAP_NORESERVE;
+# endif
+  void* base = ::mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (MAP_FAILED == base) {
+    return Status::IOError("TerarkZipTableReader::Open(): mmap()",
+      strerror(errno));
+  }
+  *data = Slice((const char*)base, size);
+  return Status::OK();
+#endif
+}
+
+// read [offset, offset + len) of file to the same offset of mem,
+// RandomAccessFileReader handles the alignment of direct io
+Status ReadToMemory(RandomAccessFileReader* file, const Slice& mem,
+                    size_t offset, size_t len) {
+  assert(offset + len <= mem.size());
+  if (0 == len) {
+    return Status::OK();
+  }
+  char* dst = (char*)mem.data() + offset;
+  Slice result;
+  Status s = file->Read(offset, len, &result, dst);
+  if (!s.ok()) {
+    return s;
+  }
+  if (result.size() != len) {
+    return Status::Corruption("TerarkZipTableReader::Open()",
+      "read store meta data: unexpected end of file");
+  }
+  if (result.data() != dst) {
+    memcpy(dst, result.data(), len);
+  }
+  return Status::OK();
+}
+
+void MunmapReadonly(const Slice& data) {
+#ifndef _MSC_VER
+  ::munmap((void*)data.data(), data.size());
+#endif
+}
+
+
+// anonymous memory backed by huge pages, to reduce TLB miss
+// @mode 0: normal pages, 1: transparent huge page,
+//       2: explicit huge page(MAP_HUGETLB)
+Status HugePageAlloc(size_t len, int mode, Slice* data, Logger* info_log) {
+#ifdef _MSC_VER
+  return Status::NotSupported("TerarkZipTableReader::Open()",
+    "indexHugePage is not supported on Windows");
+#else
+  const size_t kHugePageSize = 2 << 20;
+  const size_t kAlign = mode ? kHugePageSize : 4096;
+  size_t size = terark::align_up(len, kAlign);
+  void* base = MAP_FAILED;
+# ifdef MAP_HUGETLB
+  if (2 == mode) {
+    base = ::mmap(NULL, size, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED == base) {
+      WARN(info_log
+        , "TerarkZipTableReader::Open(): mmap(MAP_HUGETLB, %zd) = %s, use transparent huge page\n"
+        , size, strerror(errno));
+    }
+  }
+# endif
+  if (MAP_FAILED == base) {
+    // over allocate to align the address to huge page boundary
+    size_t mapSize = size + (mode ? kHugePageSize : 0);
+    auto raw = (byte_t*)::mmap(NULL, mapSize, PROT_READ|PROT_WRITE,
+                               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)raw) {
+      return Status::IOError("TerarkZipTableReader::Open(): mmap()",
+        strerror(errno));
+    }
+    auto aligned = (byte_t*)terark::align_up(size_t(raw), kAlign);
+    if (aligned != raw) {
+      ::munmap(raw, aligned - raw);
+    }
+    if (aligned + size != raw + mapSize) {
+      ::munmap(aligned + size, raw + mapSize - (aligned + size));
+    }
+    base = aligned;
+# ifdef MADV_HUGEPAGE
+    if (mode) {
+      madvise(base, size, MADV_HUGEPAGE);
+    }
+# endif
+  }
+  *data = Slice((const char*)base, size);
+  return Status::OK();
+#endif
+}
+
+// make the filled huge page memory readonly, and lock it if required
+void HugePageSeal(const Slice& data, bool lock, Logger* info_log) {
+#ifndef _MSC_VER
+  if (lock && ::mlock(data.data(), data.size()) != 0) {
+    WARN(info_log
+      , "TerarkZipTableReader::Open(): mlock(%zd) = %s, ignored\n"
+      , data.size(), strerror(errno));
+  }
+  ::mprotect((void*)data.data(), data.size(), PROT_READ);
+#endif
+}
+
+// syscalls are used directly to avoid linking libnuma
+size_t NumaNodeCount() {
+#if defined(__linux__)
+  static const size_t nodes = [] {
+    // "0", "0-1", "0,2-3" ...
+    FILE* fp = fopen("/sys/devices/system/node/online", "r");
+    if (!fp) {
+      return size_t(1);
+    }
+    char buf[256] = {};
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    size_t maxNode = 0;
+    for (size_t i = 0; i < len; ) {
+      if (isdigit((unsigned char)buf[i])) {
+        char* end = nullptr;
+        maxNode = std::max<size_t>(maxNode, strtoul(buf + i, &end, 10));
+        i = end - buf;
+      } else {
+        ++i;
+      }
+    }
+    return maxNode + 1;
+  }();
+  return nodes;
+#else
+  return 1;
+#endif
+}
+
+bool NumaBind(const Slice& mem, size_t node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  const int kMpolBind = 2; // MPOL_BIND in <numaif.h>
+  unsigned long nodeMask = 1ul << node;
+  return syscall(SYS_mbind, mem.data(), mem.size(), kMpolBind,
+                 &nodeMask, sizeof(nodeMask) * 8 + 1, 0) == 0;
+#else
+  (void)mem; (void)node;
+  return false;
+#endif
+}
 
 void UpdateCollectInfo(const TerarkZipTableFactory* table_factory,
                        const TerarkZipTableOptions* tzopt,
@@ -194,9 +370,76 @@ using terark::BadCrc32cException;
 using terark::byte_swap;
 using terark::BlobStore;
 
+/**
+ * memory of pinned keys & values of one iterator, copies are carved from
+ * chunks, each chunk is handed to PinnedIteratorsManager once when it is
+ * created, instead of one malloc'ed buffer per key and per value
+ *
+ * a chunk is shared by the iterator and the pinned manager, the manager
+ * may release pinned data while the iterator is still alive, so the chunk
+ * is freed by whichever drops its reference last
+ */
+class TerarkZipPinArena : boost::noncopyable {
+  struct Chunk {
+    size_t refs; // iterator + pinned manager
+    bool   released; // released by pinned manager
+    size_t size;
+    size_t pos;
+    byte_t data[1];
+  };
+  Chunk* chunk_ = nullptr;
+
+  enum { kChunkSize = 64 * 1024 };
+
+  static void ReleaseChunk(void* arg) {
+    auto chunk = (Chunk*)arg;
+    chunk->released = true;
+    if (--chunk->refs == 0) {
+      free(chunk);
+    }
+  }
+  void DropChunk() {
+    if (chunk_ && --chunk_->refs == 0) {
+      free(chunk_);
+    }
+    chunk_ = nullptr;
+  }
+
+public:
+  ~TerarkZipPinArena() { DropChunk(); }
+
+  Slice Pin(PinnedIteratorsManager* mgr, const Slice& data) {
+    size_t len = data.size();
+    if (0 == len) {
+      return data;
+    }
+    if (len > size_t(kChunkSize) / 4) {
+      // large one is pinned on its own
+      auto mem = (char*)malloc(len);
+      memcpy(mem, data.data(), len);
+      mgr->PinPtr(mem, free);
+      return Slice(mem, len);
+    }
+    if (!chunk_ || chunk_->released || chunk_->size - chunk_->pos < len) {
+      DropChunk();
+      chunk_ = (Chunk*)malloc(sizeof(Chunk) + kChunkSize);
+      chunk_->refs = 2;
+      chunk_->released = false;
+      chunk_->size = kChunkSize;
+      chunk_->pos = 0;
+      mgr->PinPtr(chunk_, &TerarkZipPinArena::ReleaseChunk);
+    }
+    char* mem = (char*)chunk_->data + chunk_->pos;
+    memcpy(mem, data.data(), len);
+    chunk_->pos += len;
+    return Slice(mem, len);
+  }
+};
+
 class TerarkZipTableIndexIterator : public InternalIterator {
 protected:
   const TerarkZipSubReader*         subReader_;
+  std::shared_ptr<const TerarkIndex> indexPin_; // must outlive iter_
   unique_ptr<TerarkIndex::Iterator> iter_;
 
 public:
@@ -214,17 +457,45 @@ protected:
   const TableReaderOptions* table_reader_options_;
   SequenceNumber          global_seqno_;
   ParsedInternalKey       pInterKey_;
-  std::string             interKeyBuf_;
-  valvec<byte_t>          interKeyBuf_xx_;
-  valvec<byte_t>          valueBuf_;
-  Slice                   userValue_;
+  // prefix_ + commonPrefix_ + user key + tag, only the changed part is
+  // rewritten: tag between versions, user key between records
+  valvec<byte_t>          interKeyBuf_;
+  size_t                  interKeyUserLen_; // 0: user key is not written
+  const TerarkZipSubReader* interKeyPrefixOwner_; // whose prefix is written
+  // value() loads a lazy value, these members are changed by it
+  mutable valvec<byte_t>  valueBuf_;
+  mutable Slice           userValue_;
+  mutable bool            valueLoaded_; // false: lazy, decode on value()
   ZipValueType            zValtype_;
   size_t                  valnum_;
   size_t                  validx_;
   uint32_t                value_data_offset;
   uint32_t                value_data_length;
-  Status                  status_;
+  bool                    fill_cache_;
+  mutable Status          status_;
   PinnedIteratorsManager* pinned_iters_mgr_;
+  // copies of key & value returned while pinning is enabled
+  mutable TerarkZipPinArena pinArena_;
+  mutable Slice           pinnedKey_;
+  mutable Slice           pinnedValue_;
+
+  // scan mode: records after the current one are decoded in batch
+  struct ScanRecord {
+    size_t         recId;
+    ZipValueType   type;
+    bool           ok;
+    valvec<byte_t> buf;
+  };
+  enum { kScanBatchMax = 256 };
+  std::vector<ScanRecord>           scanRing_;
+  size_t                            scanHead_;
+  size_t                            scanEnd_;
+  size_t                            scanBatch_;
+  size_t                            seqNextCount_;
+  bool                              scanAlways_;
+  const TerarkZipSubReader*         scanSubReader_;
+  std::shared_ptr<const TerarkIndex> scanIndexPin_; // must outlive scanIter_
+  unique_ptr<TerarkIndex::Iterator> scanIter_;
 
   using TerarkZipTableIndexIterator::subReader_;
   using TerarkZipTableIndexIterator::iter_;
@@ -239,11 +510,13 @@ public:
   {
     subReader_ = subReader;
     if (subReader_ != nullptr) {
-      iter_.reset(subReader_->index_->NewIterator());
+      iter_.reset(subReader_->NewIndexIterator(&indexPin_));
       iter_->SetInvalid();
     }
     pinned_iters_mgr_ = NULL;
-    TryPinBuffer(interKeyBuf_xx_);
+    interKeyUserLen_ = 0;
+    interKeyPrefixOwner_ = nullptr;
+    ResetPinnedSlices();
     validx_ = 0;
     valnum_ = 0;
     pInterKey_.user_key = Slice();
@@ -251,6 +524,21 @@ public:
     pInterKey_.type = kMaxValue;
     value_data_offset = ro.value_data_offset;
     value_data_length = ro.value_data_length;
+    fill_cache_ = ro.fill_cache;
+    scanHead_ = 0;
+    scanEnd_ = 0;
+    scanBatch_ = 32;
+    seqNextCount_ = 0;
+    scanAlways_ = false;
+    scanSubReader_ = nullptr;
+    valueLoaded_ = true;
+    if (ro.readahead_size && subReader_ != nullptr) {
+      // explicit readahead, enter scan mode on the first Next
+      size_t numRecords = std::max<size_t>(subReader_->store_->num_records(), 1);
+      size_t avgLen = std::max<size_t>(subReader_->store_->get_mmap().size() / numRecords, 1);
+      scanBatch_ = std::min<size_t>(std::max<size_t>(ro.readahead_size / avgLen, 2), kScanBatchMax);
+      scanAlways_ = true;
+    }
   }
 
   void SetPinnedItersMgr(PinnedIteratorsManager* pinned_iters_mgr) {
@@ -286,7 +574,14 @@ public:
   }
 
   void SeekForPrev(const Slice& target) override {
-    SeekForPrevImpl(target, &table_reader_options_->internal_comparator);
+    ParsedInternalKey pikey;
+    if (!ParseInternalKey(target, &pikey)) {
+      status_ = Status::InvalidArgument("TerarkZipTableIterator::SeekForPrev()",
+        "param target.size() < 8");
+      SetIterInvalid();
+      return;
+    }
+    SeekForPrevInternal(pikey);
   }
 
   void Next() override {
@@ -296,7 +591,7 @@ public:
       DecodeCurrKeyValue();
     }
     else {
-      if (UnzipIterRecord(IndexIterNext())) {
+      if (UnzipIterRecord(IndexIterNext(), true)) {
         DecodeCurrKeyValue();
       }
     }
@@ -318,11 +613,26 @@ public:
 
   Slice key() const override {
     assert(iter_->Valid());
-    return SliceOf(interKeyBuf_xx_);
+    if (IsKeyPinned()) {
+      if (pinnedKey_.data() == nullptr) {
+        pinnedKey_ = PinSlice(SliceOf(fstring(interKeyBuf_)));
+      }
+      return pinnedKey_;
+    }
+    return SliceOf(fstring(interKeyBuf_));
   }
 
   Slice value() const override {
     assert(iter_->Valid());
+    if (!valueLoaded_) {
+      LoadLazyValue();
+    }
+    if (IsValuePinned()) {
+      if (pinnedValue_.data() == nullptr) {
+        pinnedValue_ = PinSlice(userValue_);
+      }
+      return pinnedValue_;
+    }
     return userValue_;
   }
 
@@ -353,7 +663,8 @@ protected:
     }
   }
   void SeekInternal(const ParsedInternalKey& pikey) {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
+    subReader_->CountAccess(1);
     // Damn MySQL-rocksdb may use "rev:" comparator
     size_t cplen = fstringOf(pikey.user_key).commonPrefixLen(subReader_->commonPrefix_);
     if (subReader_->commonPrefix_.size() != cplen) {
@@ -380,30 +691,15 @@ protected:
     }
     else {
       bool ok;
-      int cmp; // compare(iterKey, searchKey)
-      ok = iter_->Seek(fstringOf(pikey.user_key).substr(cplen));
-      if (reverse) {
-        if (!ok) {
-          // searchKey is reverse_bytewise less than all keys in database
-          iter_->SeekToLast();
-          assert(iter_->Valid()); // TerarkIndex should not empty
-          ok = true;
-          cmp = -1;
-        }
-        else {
-          cmp = SliceOf(iter_->key()).compare(SubStr(pikey.user_key, cplen));
-          if (cmp != 0) {
-            assert(cmp > 0);
-            iter_->Prev();
-            ok = iter_->Valid();
-          }
-        }
-      }
-      else {
-        cmp = 0;
-        if (ok)
-          cmp = SliceOf(iter_->key()).compare(SubStr(pikey.user_key, cplen));
-      }
+      int cmp = 0; // compare(iterKey, searchKey)
+      fstring searchKey = fstringOf(pikey.user_key).substr(cplen);
+      if (reverse)
+        // first key >= searchKey in reverse bytewise order
+        ok = iter_->SeekMaxLE(searchKey);
+      else
+        ok = iter_->Seek(searchKey);
+      if (ok)
+        cmp = SliceOf(iter_->key()).compare(SliceOf(searchKey));
       if (UnzipIterRecord(ok)) {
         if (0 == cmp) {
           validx_ = size_t(-1);
@@ -424,8 +720,62 @@ protected:
       }
     }
   }
+  // position at the last entry <= pikey in table order, the index is
+  // positioned first, so only the result record is decompressed
+  void SeekForPrevInternal(const ParsedInternalKey& pikey) {
+    ResetKeyBuffer();
+    subReader_->CountAccess(1);
+    size_t cplen = fstringOf(pikey.user_key).commonPrefixLen(subReader_->commonPrefix_);
+    if (subReader_->commonPrefix_.size() != cplen) {
+      bool beforeAll; // target is less than all keys in table order
+      if (pikey.user_key.size() == cplen) {
+        assert(pikey.user_key.size() < subReader_->commonPrefix_.size());
+        beforeAll = !reverse;
+      }
+      else {
+        assert(pikey.user_key.size() > cplen);
+        assert(pikey.user_key[cplen] != subReader_->commonPrefix_[cplen]);
+        beforeAll = (byte_t(pikey.user_key[cplen]) < subReader_->commonPrefix_[cplen]) ^ reverse;
+      }
+      if (beforeAll)
+        SetIterInvalid();
+      else if (reverse)
+        SeekToAscendingFirst();
+      else
+        SeekToAscendingLast();
+      return;
+    }
+    fstring searchKey = fstringOf(pikey.user_key).substr(cplen);
+    bool ok;
+    if (reverse)
+      // last key <= searchKey in reverse bytewise order
+      ok = iter_->Seek(searchKey);
+    else
+      ok = iter_->SeekMaxLE(searchKey);
+    bool equal = ok && iter_->key() == searchKey;
+    if (UnzipIterRecord(ok)) {
+      if (equal) {
+        // versions are in descending seq order, the last one whose
+        // sequence >= target is the last entry <= target
+        validx_ = valnum_;
+        do {
+          validx_--;
+          DecodeCurrKeyValue();
+          if (pInterKey_.sequence >= pikey.sequence) {
+            return; // done
+          }
+        } while (validx_ > 0);
+        // all versions are after target, validx_ == 0 here
+        Prev();
+      }
+      else {
+        validx_ = valnum_ - 1;
+        DecodeCurrKeyValue();
+      }
+    }
+  }
   void SetIterInvalid() {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
     if (iter_)
       iter_->SetInvalid();
     validx_ = 0;
@@ -435,28 +785,28 @@ protected:
     pInterKey_.type = kMaxValue;
   }
   virtual bool IndexIterSeekToFirst() {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
     if (reverse)
       return iter_->SeekToLast();
     else
       return iter_->SeekToFirst();
   }
   virtual bool IndexIterSeekToLast() {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
     if (reverse)
       return iter_->SeekToFirst();
     else
       return iter_->SeekToLast();
   }
   virtual bool IndexIterPrev() {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
     if (reverse)
       return iter_->Next();
     else
       return iter_->Prev();
   }
   virtual bool IndexIterNext() {
-    TryPinBuffer(interKeyBuf_xx_);
+    ResetKeyBuffer();
     if (reverse)
       return iter_->Prev();
     else
@@ -464,31 +814,181 @@ protected:
   }
   virtual void DecodeCurrKeyValue() {
     DecodeCurrKeyValueInternal();
-    interKeyBuf_.assign(subReader_->commonPrefix_.data(), subReader_->commonPrefix_.size());
-    AppendInternalKey(&interKeyBuf_, pInterKey_);
-    interKeyBuf_xx_.assign((byte_t*)interKeyBuf_.data(), interKeyBuf_.size());
+    if (0 == interKeyUserLen_) {
+      auto& prefix = subReader_->prefix_;
+      auto& commonPrefix = subReader_->commonPrefix_;
+      size_t prefixLen = prefix.size() + commonPrefix.size();
+      if (interKeyPrefixOwner_ != subReader_) {
+        interKeyBuf_.assign((const byte_t*)prefix.data(), prefix.size());
+        interKeyBuf_.append((const byte_t*)commonPrefix.data(), commonPrefix.size());
+        interKeyPrefixOwner_ = subReader_;
+      }
+      interKeyBuf_.risk_set_size(prefixLen);
+      interKeyBuf_.append((const byte_t*)pInterKey_.user_key.data(),
+                          pInterKey_.user_key.size());
+      interKeyUserLen_ = interKeyBuf_.size();
+    }
+    SetInterKeyTag();
+  }
+  void SetInterKeyTag() {
+    assert(interKeyUserLen_ != 0);
+    interKeyBuf_.resize_no_init(interKeyUserLen_ + 8);
+    EncodeFixed64((char*)interKeyBuf_.data() + interKeyUserLen_,
+      PackSequenceAndType(pInterKey_.sequence, pInterKey_.type));
+  }
+  // buffers are reused, key() & value() return copies in pinArena_
+  // when pinning is enabled
+  Slice PinSlice(const Slice& data) const {
+    Slice pinned = pinArena_.Pin(pinned_iters_mgr_, data);
+    // never nullptr, so the copy is made only once per position
+    return pinned.data() ? pinned : Slice("", 0);
+  }
+  void ResetPinnedSlices() {
+    pinnedKey_ = Slice(nullptr, 0);
+    pinnedValue_ = Slice(nullptr, 0);
+  }
+  // called before moving to another record
+  void ResetKeyBuffer() {
+    interKeyUserLen_ = 0;
+    ResetPinnedSlices();
+  }
+  // key only iteration: value_data_length == 0 or lazyIterValue
+  bool IsLazyValue() const {
+    return 0 == value_data_length || subReader_->lazyIterValue_;
+  }
+  void LoadLazyValue() const {
+    assert(!valueLoaded_);
+    valueLoaded_ = true;
+    if (0 == value_data_length) {
+      return; // userValue_ is empty
+    }
+    try {
+      FetchRecord(iter_->id(), zValtype_, &valueBuf_);
+    }
+    catch (const BadCrc32cException& ex) {
+      status_ = Status::Corruption(
+        "TerarkZipTableIterator::value()", ex.what());
+      userValue_ = Slice();
+      // Valid() must be false with a bad status, Next() & Prev() require
+      // status_.ok(), the caller has to Seek again
+      iter_->SetInvalid();
+      return;
+    }
+    if (ZipValueType::kZeroSeq == zValtype_) {
+      userValue_ = SliceOf(valueBuf_);
+    }
+    else {
+      assert(ZipValueType::kValue == zValtype_);
+      userValue_ = SliceOf(fstring(valueBuf_).substr(7));
+    }
+  }
+  void FetchRecord(size_t recId, ZipValueType type, valvec<byte_t>* buf) const {
+    if (ZipValueType::kMulti == type) {
+      buf->resize_no_init(sizeof(uint32_t)); // for offsets[valnum_]
+      subReader_->GetRecordAppend(recId, buf, fill_cache_);
+    }
+    else {
+      buf->erase_all();
+      // kValue & kDelete have a 7 bytes seq header
+      size_t headerLen = ZipValueType::kZeroSeq == type ? 0 : 7;
+      if (headerLen && !subReader_->seqColumn_.Empty()) {
+        // header is not in the record, build it from the seq column
+        subReader_->GetSeqHeaderAppend(recId, buf);
+        headerLen = 0;
+      }
+      subReader_->GetRecordAppend(recId, buf, headerLen,
+        value_data_offset, value_data_length, fill_cache_);
+    }
   }
-  void TryPinBuffer(valvec<byte_t>& buf) {
-    if (pinned_iters_mgr_ && pinned_iters_mgr_->PinningEnabled()) {
-      pinned_iters_mgr_->PinPtr(buf.data(), free);
-      buf.risk_release_ownership();
+  // decode the records from current position of iter_ into scanRing_
+  bool FillScanRing() {
+    if (scanSubReader_ != subReader_) {
+      scanSubReader_ = subReader_;
+      scanIter_.reset();
+      scanIter_.reset(subReader_->NewIndexIterator(&scanIndexPin_));
+    }
+    scanHead_ = scanEnd_ = 0;
+    if (!scanIter_->Seek(iter_->key()) || scanIter_->id() != iter_->id()) {
+      return false;
+    }
+    auto& type = subReader_->GetType();
+    valvec<size_t> recIds;
+    size_t num = 0;
+    do {
+      if (scanRing_.size() == num) {
+        scanRing_.emplace_back();
+      }
+      auto& r = scanRing_[num++];
+      r.recId = scanIter_->id();
+      r.type = type.size() ? ZipValueType(type[r.recId]) : ZipValueType::kZeroSeq;
+      recIds.push_back(r.recId);
+    } while (num < scanBatch_ && (reverse ? scanIter_->Prev() : scanIter_->Next()));
+    subReader_->ReadAheadRecords(recIds.data(), recIds.size());
+    auto fetch = [this](size_t i) {
+      auto& r = scanRing_[i];
+      try {
+        FetchRecord(r.recId, r.type, &r.buf);
+        r.ok = true;
+      }
+      catch (const std::exception&) {
+        r.ok = false; // decode again by UnzipIterRecord to report error
+      }
+    };
+    if (subReader_->ioPool_) {
+      subReader_->ioPool_->ParallelFor(num, fetch);
+    }
+    else {
+      for (size_t i = 0; i < num; ++i) {
+        fetch(i);
+      }
+    }
+    while (scanEnd_ < num && scanRing_[scanEnd_].ok) {
+      ++scanEnd_;
     }
+    return scanEnd_ > 0;
   }
-  bool UnzipIterRecord(bool hasRecord) {
+  bool TakeScanRecord(size_t recId) {
+    if (scanHead_ == scanEnd_ && !FillScanRing()) {
+      seqNextCount_ = 0; // back off
+      return false;
+    }
+    auto& r = scanRing_[scanHead_];
+    if (r.recId != recId || scanSubReader_ != subReader_) {
+      scanHead_ = scanEnd_ = 0;
+      return false;
+    }
+    valueBuf_.swap(r.buf);
+    scanHead_++;
+    return true;
+  }
+  bool UnzipIterRecord(bool hasRecord, bool sequential = false) {
+    if (!sequential) {
+      seqNextCount_ = 0;
+      scanHead_ = scanEnd_ = 0;
+    }
     if (hasRecord) {
       size_t recId = iter_->id();
-      zValtype_ = subReader_->type_.size()
-        ? ZipValueType(subReader_->type_[recId])
+      auto& type = subReader_->GetType();
+      zValtype_ = type.size()
+        ? ZipValueType(type[recId])
         : ZipValueType::kZeroSeq;
       try {
-        TryPinBuffer(valueBuf_);
-        if (ZipValueType::kMulti == zValtype_) {
-          valueBuf_.resize_no_init(sizeof(uint32_t)); // for offsets[valnum_]
-          subReader_->GetRecordAppend(recId, &valueBuf_);
+        valueLoaded_ = true;
+        if (ZipValueType::kMulti != zValtype_ && IsLazyValue()) {
+          // kZeroSeq needs nothing, kValue & kDelete need the seq header
+          valueBuf_.erase_all();
+          if (ZipValueType::kZeroSeq != zValtype_) {
+            subReader_->GetSeqHeaderAppend(recId, &valueBuf_);
+          }
+          valueLoaded_ = ZipValueType::kDelete == zValtype_;
         }
         else {
-          valueBuf_.erase_all();
-          subReader_->GetRecordAppend(recId, &valueBuf_, value_data_offset, value_data_length);
+          size_t trigger = subReader_->scanTriggerNext_;
+          bool scan = sequential && (scanAlways_ ||
+            (trigger && ++seqNextCount_ >= trigger));
+          if (!scan || !TakeScanRecord(recId)) {
+            FetchRecord(recId, zValtype_, &valueBuf_);
+          }
         }
       }
       catch (const BadCrc32cException& ex) { // crc checksum error
@@ -524,6 +1024,7 @@ protected:
       }
       validx_ = 0;
       pInterKey_.user_key = SliceOf(iter_->key());
+      interKeyUserLen_ = 0;
       return true;
     }
     else {
@@ -533,6 +1034,7 @@ protected:
   }
   void DecodeCurrKeyValueInternal() {
     assert(status_.ok());
+    ResetPinnedSlices();
     assert(iter_->id() < subReader_->index_->NumKeys());
     switch (zValtype_) {
     default:
@@ -545,7 +1047,7 @@ protected:
       assert(1 == valnum_);
       pInterKey_.sequence = global_seqno_;
       pInterKey_.type = kTypeValue;
-      userValue_ = SliceOf(valueBuf_);
+      userValue_ = valueLoaded_ ? SliceOf(valueBuf_) : Slice();
       break;
     case ZipValueType::kValue: // should be a kTypeValue, the normal case
       assert(0 == validx_);
@@ -553,7 +1055,7 @@ protected:
       // little endian uint64_t
       pInterKey_.sequence = *(uint64_t*)valueBuf_.data() & kMaxSequenceNumber;
       pInterKey_.type = kTypeValue;
-      userValue_ = SliceOf(fstring(valueBuf_).substr(7));
+      userValue_ = valueLoaded_ ? SliceOf(fstring(valueBuf_).substr(7)) : Slice();
       break;
     case ZipValueType::kDelete:
       assert(0 == validx_);
@@ -578,6 +1080,148 @@ protected:
 };
 
 
+template<bool reverse>
+class TerarkZipTableMultiIterator : public TerarkZipTableIterator<reverse> {
+public:
+  TerarkZipTableMultiIterator(const TableReaderOptions& tro
+                            , const TerarkZipTableMultiReader::SubIndex& subIndex
+                            , const ReadOptions& ro
+                            , SequenceNumber global_seqno)
+    : TerarkZipTableIterator<reverse>(tro, subIndex.GetSubReader(0), ro, global_seqno)
+    , subIndex_(&subIndex)
+    , partIndex_(0) {
+  }
+protected:
+  typedef TerarkZipTableIterator<reverse> base_t;
+  using base_t::subReader_;
+  using base_t::iter_;
+  using base_t::indexPin_;
+  using base_t::status_;
+
+  using base_t::SeekInternal;
+  using base_t::SeekForPrevInternal;
+  using base_t::SetIterInvalid;
+  using base_t::UnzipIterRecord;
+
+  const TerarkZipTableMultiReader::SubIndex* subIndex_;
+  size_t partIndex_;
+
+  void ResetSubReader(size_t partIndex) {
+    if (partIndex_ != partIndex) {
+      partIndex_ = partIndex;
+      subReader_ = subIndex_->GetSubReader(partIndex);
+      iter_.reset();
+      iter_.reset(subReader_->NewIndexIterator(&indexPin_));
+      iter_->SetInvalid();
+    }
+  }
+  void SeekToPartFirst(size_t partIndex) {
+    ResetSubReader(partIndex);
+    if (UnzipIterRecord(base_t::IndexIterSeekToFirst())) {
+      this->DecodeCurrKeyValue();
+    }
+  }
+  void SeekToPartLast(size_t partIndex) {
+    ResetSubReader(partIndex);
+    if (UnzipIterRecord(base_t::IndexIterSeekToLast())) {
+      this->validx_ = this->valnum_ - 1;
+      this->DecodeCurrKeyValue();
+    }
+  }
+
+public:
+  void Seek(const Slice& target) override {
+    ParsedInternalKey pikey;
+    if (!ParseInternalKey(target, &pikey)) {
+      status_ = Status::InvalidArgument("TerarkZipTableIterator::Seek()",
+        "param target.size() < 8");
+      SetIterInvalid();
+      return;
+    }
+    const size_t partCount = subIndex_->GetPartCount();
+    size_t partIndex = subIndex_->LowerBound(fstringOf(pikey.user_key));
+    if (partIndex < partCount &&
+        fstringOf(pikey.user_key).startsWith(subIndex_->GetPrefix(partIndex))) {
+      ResetSubReader(partIndex);
+      pikey.user_key.remove_prefix(subIndex_->GetPrefixLen());
+      SeekInternal(pikey);
+      if (this->Valid() || !status_.ok()) {
+        return;
+      }
+      // target is after all keys of this part
+      ++partIndex;
+    }
+    if (partIndex < partCount) {
+      SeekToPartFirst(partIndex);
+    }
+    else {
+      SetIterInvalid();
+    }
+  }
+  void SeekForPrev(const Slice& target) override {
+    ParsedInternalKey pikey;
+    if (!ParseInternalKey(target, &pikey)) {
+      status_ = Status::InvalidArgument("TerarkZipTableIterator::SeekForPrev()",
+        "param target.size() < 8");
+      SetIterInvalid();
+      return;
+    }
+    const size_t partCount = subIndex_->GetPartCount();
+    size_t partIndex = subIndex_->LowerBound(fstringOf(pikey.user_key));
+    if (partIndex < partCount &&
+        fstringOf(pikey.user_key).startsWith(subIndex_->GetPrefix(partIndex))) {
+      ResetSubReader(partIndex);
+      pikey.user_key.remove_prefix(subIndex_->GetPrefixLen());
+      SeekForPrevInternal(pikey);
+      if (this->Valid() || !status_.ok()) {
+        return;
+      }
+      // target is before all keys of this part
+    }
+    if (partIndex > 0) {
+      SeekToPartLast(partIndex - 1);
+    }
+    else {
+      SetIterInvalid();
+    }
+  }
+
+protected:
+  bool IndexIterSeekToFirst() override {
+    ResetSubReader(0);
+    return base_t::IndexIterSeekToFirst();
+  }
+  bool IndexIterSeekToLast() override {
+    ResetSubReader(subIndex_->GetPartCount() - 1);
+    return base_t::IndexIterSeekToLast();
+  }
+  bool IndexIterPrev() override {
+    if (base_t::IndexIterPrev()) {
+      return true;
+    }
+    while (partIndex_ > 0) {
+      ResetSubReader(partIndex_ - 1);
+      if (base_t::IndexIterSeekToLast()) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool IndexIterNext() override {
+    if (base_t::IndexIterNext()) {
+      return true;
+    }
+    while (partIndex_ + 1 < subIndex_->GetPartCount()) {
+      ResetSubReader(partIndex_ + 1);
+      if (base_t::IndexIterSeekToFirst()) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
 class TerarkZipTableUint64Iterator : public TerarkZipTableIterator<false> {
 public:
@@ -592,10 +1236,12 @@ protected:
   using base_t::subReader_;
   using base_t::pInterKey_;
   using base_t::interKeyBuf_;
-  using base_t::interKeyBuf_xx_;
+  using base_t::interKeyUserLen_;
+  using base_t::interKeyPrefixOwner_;
   using base_t::status_;
 
   using base_t::SeekInternal;
+  using base_t::SeekForPrevInternal;
   using base_t::DecodeCurrKeyValueInternal;
 
 public:
@@ -613,14 +1259,31 @@ public:
     pikey.user_key = Slice(reinterpret_cast<const char*>(&u64_target), 8);
     SeekInternal(pikey);
   }
+  void SeekForPrev(const Slice& target) override {
+    ParsedInternalKey pikey;
+    if (!ParseInternalKey(target, &pikey)) {
+      status_ = Status::InvalidArgument("TerarkZipTableIterator::SeekForPrev()",
+        "param target.size() < 8");
+      SetIterInvalid();
+      return;
+    }
+    uint64_t u64_target;
+    assert(pikey.user_key.size() == 8);
+    u64_target = byte_swap(*reinterpret_cast<const uint64_t*>(pikey.user_key.data()));
+    pikey.user_key = Slice(reinterpret_cast<const char*>(&u64_target), 8);
+    SeekForPrevInternal(pikey);
+  }
   void DecodeCurrKeyValue() override {
     DecodeCurrKeyValueInternal();
-    interKeyBuf_.assign(subReader_->commonPrefix_.data(), subReader_->commonPrefix_.size());
-    AppendInternalKey(&interKeyBuf_, pInterKey_);
-    assert(interKeyBuf_.size() == 16);
-    uint64_t *ukey = reinterpret_cast<uint64_t*>(&interKeyBuf_[0]);
-    *ukey = byte_swap(*ukey);
-    interKeyBuf_xx_.assign((byte_t*)interKeyBuf_.data(), interKeyBuf_.size());
+    if (0 == interKeyUserLen_) {
+      assert(subReader_->commonPrefix_.empty());
+      assert(pInterKey_.user_key.size() == 8);
+      uint64_t ukey = byte_swap(unaligned_load<uint64_t>(pInterKey_.user_key.data()));
+      interKeyBuf_.assign((const byte_t*)&ukey, 8);
+      interKeyUserLen_ = 8;
+      interKeyPrefixOwner_ = nullptr; // no prefix in buffer
+    }
+    this->SetInterKeyTag();
   }
 };
 #endif
@@ -665,64 +1328,239 @@ void TerarkZipSubReader::InitUsePread(int minPreadLen) {
   }
 }
 
-void TerarkZipSubReader::GetRecordAppend(size_t recId, valvec<byte_t>* tbuf,
-                                         uint32_t offset, uint32_t length)
+void TerarkZipSubReader::ReadAheadRecords(const size_t* recIds, size_t num)
 const {
-  if (0 == offset && UINT32_MAX == length) {
-    if (storeUsePread_)
-      store_->pread_record_append(cache_, storeFD_, storeOffset_, recId, tbuf);
-    else
-      store_->get_record_append(recId, tbuf);
+  if (storeUsePread_ || 0 == num) {
+    return;
   }
-  else {
-    assert(0);
-    if (storeUsePread_)
-      assert(0);
-    else
-      store_->get_slice_append(recId, offset, length, tbuf);
+  // record positions are not exposed by BlobStore, estimate them by the
+  // average record length, records are laid out in recId order
+  fstring mem = store_->get_mmap();
+  size_t numRecords = store_->num_records();
+  if (0 == numRecords) {
+    return;
+  }
+  size_t avgLen = mem.size() / numRecords + 1;
+  valvec<size_t> pos;
+  pos.assign(recIds, num);
+  std::sort(pos.begin(), pos.end());
+  size_t i = 0;
+  while (i < num) {
+    size_t beg = pos[i] * mem.size() / numRecords;
+    size_t end = beg + 2 * avgLen;
+    for (++i; i < num; ++i) {
+      size_t next = pos[i] * mem.size() / numRecords;
+      if (next > end + 4096) {
+        break;
+      }
+      end = next + 2 * avgLen;
+    }
+    end = std::min(end, mem.size());
+    if (beg < end) {
+      MmapWillNeed(mem.data() + beg, end - beg);
+    }
   }
 }
 
-void TerarkZipSubReader::GetRecordAppend(size_t recId, valvec<byte_t>* tbuf)
-const {
-  if (storeUsePread_)
-    store_->pread_record_append(cache_, storeFD_, storeOffset_, recId, tbuf);
-  else
-    store_->get_record_append(recId, tbuf);
+static size_t CurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  // getcpu is not in vdso on all platforms, refresh the node periodically
+  MY_THREAD_LOCAL(unsigned, t_node);
+  MY_THREAD_LOCAL(unsigned, t_calls);
+  if (t_calls++ % 1024 == 0) {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+      t_node = node;
+    }
+  }
+  return t_node;
+#else
+  return 0;
+#endif
 }
 
-Status TerarkZipSubReader::Get(SequenceNumber global_seqno,
-                               const ReadOptions& ro, const Slice& ikey,
-                               GetContext* get_context, int flag)
+const TerarkIndex*
+TerarkZipSubReader::GetIndex(std::shared_ptr<const TerarkIndex>* pin) const {
+  // cachedIndex_ avoids the lock of atomic_load when nothing is cached
+  if (cachedIndex_.load(std::memory_order_acquire)) {
+    *pin = std::atomic_load(&cachedIndexHolder_);
+    if (*pin) {
+      return pin->get();
+    }
+  }
+  return GetUncachedIndex();
+}
+
+TerarkIndex::Iterator*
+TerarkZipSubReader::NewIndexIterator(std::shared_ptr<const TerarkIndex>* pin)
 const {
-  (void)flag;
-  MY_THREAD_LOCAL(valvec<byte_t>, g_tbuf);
-  ParsedInternalKey pikey;
-  if (!ParseInternalKey(ikey, &pikey)) {
-    return Status::InvalidArgument("TerarkZipTableReader::Get()",
-      "bad internal key causing ParseInternalKey() failed");
+  return GetIndex(pin)->NewIterator();
+}
+
+const TerarkIndex* TerarkZipSubReader::GetUncachedIndex() const {
+  if (numaNodes_) {
+    size_t node = CurrentNumaNode();
+    if (node < numaNodes_) {
+      return numaReplica_[node].index.get();
+    }
   }
-  Slice user_key = pikey.user_key;
+  return index_.get();
+}
+
+const bitfield_array<2>& TerarkZipSubReader::GetType() const {
+  if (numaNodes_) {
+    size_t node = CurrentNumaNode();
+    if (node < numaNodes_) {
+      return numaReplica_[node].type;
+    }
+  }
+  return type_;
+}
+
+void TerarkZipSubReader::CountAccess(size_t n) const {
+  if (!countAccess_) {
+    return;
+  }
+  // sampled, a thread adds 16 to the table which hits its 16th lookup,
+  // to avoid contention on the shared counter
+  MY_THREAD_LOCAL(size_t, t_access);
+  size_t ticks = (t_access + n) / 16 - t_access / 16;
+  t_access += n;
+  if (ticks) {
+    accessCount_.fetch_add(ticks * 16, std::memory_order_relaxed);
+  }
+}
+
+void TerarkZipSubReader::BuildCache(double cacheRatio) {
+  index_->BuildCache(cacheRatio);
+  for (size_t i = 0; i < numaNodes_; ++i) {
+    numaReplica_[i].index->BuildCache(cacheRatio);
+  }
+}
+
+void TerarkZipSubReader::GetRecordAppend(size_t recId, valvec<byte_t>* tbuf,
+                                         size_t headerLen,
+                                         uint32_t offset, uint32_t length,
+                                         bool fillCache)
+const {
+  if (0 == offset && UINT32_MAX == length) {
+    GetRecordAppend(recId, tbuf, fillCache);
+  }
+  else if (!storeUsePread_ && !(valueCache_ && fillCache)) {
+    // decode only the needed bytes from mmap
+    if (headerLen) {
+      store_->get_slice_append(recId, 0, headerLen, tbuf);
+    }
+    if (length) {
+      store_->get_slice_append(recId, headerLen + offset, length, tbuf);
+    }
+  }
+  else {
+    // pread fetches the whole record anyway, decode it to a scratch
+    // buffer (and value cache), then copy header and the slice
+    MY_THREAD_LOCAL(valvec<byte_t>, g_rbuf);
+    g_rbuf.erase_all();
+    GetRecordAppend(recId, &g_rbuf, fillCache);
+    size_t size = g_rbuf.size();
+    size_t beg = std::min(headerLen + offset, size);
+    size_t end = std::min(beg + length, size);
+    tbuf->append(g_rbuf.data(), std::min(headerLen, size));
+    tbuf->append(g_rbuf.data() + beg, end - beg);
+    if (g_rbuf.capacity() > 512 * 1024) {
+      g_rbuf.clear(); // free large thread local memory
+    }
+  }
+}
+
+void TerarkZipSubReader::GetRecordAppend(size_t recId, valvec<byte_t>* tbuf,
+                                         bool fillCache)
+const {
+  char cacheKeyBuf[16];
+  Slice cacheKey;
+  if (valueCache_) {
+    EncodeFixed64(cacheKeyBuf, valueCacheId_);
+    EncodeFixed64(cacheKeyBuf + 8, recId);
+    cacheKey = Slice(cacheKeyBuf, sizeof cacheKeyBuf);
+    if (auto handle = valueCache_->Lookup(cacheKey)) {
+      auto cached = (const std::string*)valueCache_->Value(handle);
+      tbuf->append((const byte_t*)cached->data(), cached->size());
+      valueCache_->Release(handle);
+      return;
+    }
+  }
+  size_t oldsize = tbuf->size();
+  if (storeUsePread_)
+    store_->pread_record_append(cache_, storeFD_, storeOffset_, recId, tbuf);
+  else
+    store_->get_record_append(recId, tbuf);
+  if (valueCache_ && fillCache) {
+    auto cached = new std::string((const char*)tbuf->data() + oldsize,
+                                  tbuf->size() - oldsize);
+    valueCache_->Insert(cacheKey, cached, cached->size() + sizeof(std::string),
+      [](const Slice&, void* value) { delete (std::string*)value; });
+  }
+}
+
+void TerarkZipSubReader::GetSeqHeaderAppend(size_t recId,
+                                            valvec<byte_t>* tbuf)
+const {
+  tbuf->reserve(tbuf->size() + 8); // readers load the header as uint64
+  if (!seqColumn_.Empty()) {
+    uint64_t seq = seqColumn_.get(recId); // little endian
+    tbuf->append((const byte_t*)&seq, 7);
+  }
+  else if (!storeUsePread_) {
+    // decode only the header from mmap, even if it may be in valueCache_
+    store_->get_slice_append(recId, 0, 7, tbuf);
+  }
+  else {
+    // pread fetches the whole record anyway, the value cache is looked up
+    // but not filled by a header only read
+    MY_THREAD_LOCAL(valvec<byte_t>, g_rbuf);
+    g_rbuf.erase_all();
+    GetRecordAppend(recId, &g_rbuf, false);
+    tbuf->append(g_rbuf.data(), std::min<size_t>(7, g_rbuf.size()));
+    if (g_rbuf.capacity() > 512 * 1024) {
+      g_rbuf.clear(); // free large thread local memory
+    }
+  }
+}
+
+bool TerarkZipSubReader::GetSearchKey(const Slice& user_key, int flag,
+                                      uint64_t* u64_buf, fstring* search_key)
+const {
+  Slice key = user_key;
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
-  uint64_t u64_target;
   if (flag & FlagUint64Comparator) {
-    assert(pikey.user_key.size() == 8);
-    u64_target = byte_swap(*reinterpret_cast<const uint64_t*>(pikey.user_key.data()));
-    user_key = Slice(reinterpret_cast<const char*>(&u64_target), 8);
+    assert(key.size() == 8);
+    *u64_buf = byte_swap(*reinterpret_cast<const uint64_t*>(key.data()));
+    key = Slice(reinterpret_cast<const char*>(u64_buf), 8);
   }
+#else
+  (void)flag;
+  (void)u64_buf;
 #endif
-  assert(user_key.starts_with(prefix_));
-  user_key.remove_prefix(prefix_.size());
-  size_t cplen = user_key.difference_offset(commonPrefix_);
+  assert(key.starts_with(prefix_));
+  key.remove_prefix(prefix_.size());
+  size_t cplen = key.difference_offset(commonPrefix_);
   if (commonPrefix_.size() != cplen) {
-    return Status::OK();
+    return false;
   }
-  size_t recId = index_->Find(fstringOf(user_key).substr(cplen));
-  if (size_t(-1) == recId) {
-    return Status::OK();
-  }
-  auto zvType = type_.size()
-    ? ZipValueType(type_[recId])
+  *search_key = fstringOf(key).substr(cplen);
+  return true;
+}
+
+Status TerarkZipSubReader::GetRecord(SequenceNumber global_seqno,
+                                     const ReadOptions& ro,
+                                     const ParsedInternalKey& pikey,
+                                     size_t recId,
+                                     GetContext* get_context,
+                                     valvec<byte_t>* tbuf)
+const {
+  auto& g_tbuf = *tbuf;
+  auto& type = GetType();
+  auto zvType = type.size()
+    ? ZipValueType(type[recId])
     : ZipValueType::kZeroSeq;
   switch (zvType) {
   default:
@@ -730,7 +1568,8 @@ const {
   case ZipValueType::kZeroSeq:
     g_tbuf.erase_all();
     try {
-      GetRecordAppend(recId, &g_tbuf, ro.value_data_offset, ro.value_data_length);
+      GetRecordAppend(recId, &g_tbuf, 0,
+                      ro.value_data_offset, ro.value_data_length, ro.fill_cache);
     }
     catch (const terark::BadChecksumException& ex) {
       return Status::Corruption("TerarkZipTableReader::Get()", ex.what());
@@ -740,8 +1579,26 @@ const {
     break;
   case ZipValueType::kValue: { // should be a kTypeValue, the normal case
     g_tbuf.erase_all();
+    if (!seqColumn_.Empty()) {
+      // filter by seq before touching the value store
+      uint64_t seq = seqColumn_.get(recId);
+      if (seq > pikey.sequence) {
+        break;
+      }
+      try {
+        GetRecordAppend(recId, &g_tbuf, 0,
+                        ro.value_data_offset, ro.value_data_length, ro.fill_cache);
+      }
+      catch (const terark::BadChecksumException& ex) {
+        return Status::Corruption("TerarkZipTableReader::Get()", ex.what());
+      }
+      get_context->SaveValue(ParsedInternalKey(pikey.user_key, seq, kTypeValue),
+        Slice((char*)g_tbuf.data(), g_tbuf.size()));
+      break;
+    }
     try {
-      GetRecordAppend(recId, &g_tbuf, ro.value_data_offset, ro.value_data_length);
+      GetRecordAppend(recId, &g_tbuf, 7, // keep the seq header
+                      ro.value_data_offset, ro.value_data_length, ro.fill_cache);
     }
     catch (const terark::BadChecksumException& ex) {
       return Status::Corruption("TerarkZipTableReader::Get()", ex.what());
@@ -754,10 +1611,18 @@ const {
     }
     break; }
   case ZipValueType::kDelete: {
+    if (!seqColumn_.Empty()) {
+      uint64_t seq = seqColumn_.get(recId);
+      if (seq <= pikey.sequence) {
+        get_context->SaveValue(ParsedInternalKey(pikey.user_key, seq, kTypeDeletion),
+          Slice());
+      }
+      break;
+    }
     g_tbuf.erase_all();
     try {
       g_tbuf.reserve(sizeof(SequenceNumber));
-      GetRecordAppend(recId, &g_tbuf);
+      GetRecordAppend(recId, &g_tbuf, ro.fill_cache);
       assert(g_tbuf.size() == sizeof(SequenceNumber) - 1);
     }
     catch (const terark::BadChecksumException& ex) {
@@ -772,7 +1637,7 @@ const {
   case ZipValueType::kMulti: { // more than one value
     g_tbuf.resize_no_init(sizeof(uint32_t));
     try {
-      GetRecordAppend(recId, &g_tbuf);
+      GetRecordAppend(recId, &g_tbuf, ro.fill_cache);
     }
     catch (const terark::BadChecksumException& ex) {
       return Status::Corruption("TerarkZipTableReader::Get()", ex.what());
@@ -809,10 +1674,190 @@ const {
     }
     break; }
   }
+  return Status::OK();
+}
+
+Status TerarkZipSubReader::Get(SequenceNumber global_seqno,
+                               const ReadOptions& ro, const Slice& ikey,
+                               GetContext* get_context, int flag)
+const {
+  MY_THREAD_LOCAL(valvec<byte_t>, g_tbuf);
+  ParsedInternalKey pikey;
+  if (!ParseInternalKey(ikey, &pikey)) {
+    return Status::InvalidArgument("TerarkZipTableReader::Get()",
+      "bad internal key causing ParseInternalKey() failed");
+  }
+  if (filter_ && !(flag & FlagSkipFilter) &&
+      !filter_->MayMatch(TerarkZipBloomFilter::Hash(fstringOf(pikey.user_key)))) {
+    return Status::OK();
+  }
+  uint64_t u64_target;
+  fstring searchKey;
+  if (!GetSearchKey(pikey.user_key, flag, &u64_target, &searchKey)) {
+    return Status::OK();
+  }
+  CountAccess(1);
+  std::shared_ptr<const TerarkIndex> indexPin;
+  size_t recId = GetIndex(&indexPin)->Find(searchKey);
+  if (size_t(-1) == recId) {
+    return Status::OK();
+  }
+  Status s = GetRecord(global_seqno, ro, pikey, recId, get_context, &g_tbuf);
   if (g_tbuf.capacity() > 512 * 1024) {
     g_tbuf.clear(); // free large thread local memory
   }
-  return Status::OK();
+  return s;
+}
+
+void TerarkZipSubReader::MultiGet(SequenceNumber global_seqno,
+                                  const ReadOptions& ro, size_t num,
+                                  const Slice* ikeys,
+                                  GetContext** get_context,
+                                  Status* status, int flag)
+const {
+  MY_THREAD_LOCAL(valvec<byte_t>, g_tbuf);
+  struct BatchItem {
+    ParsedInternalKey pikey;
+    fstring searchKey;
+    size_t  recId;
+    size_t  idx;
+  };
+  std::vector<BatchItem> batch;
+  valvec<uint64_t> u64_targets(num, valvec_no_init());
+  batch.reserve(num);
+  for (size_t i = 0; i < num; ++i) {
+    BatchItem item;
+    status[i] = Status::OK();
+    if (!ParseInternalKey(ikeys[i], &item.pikey)) {
+      status[i] = Status::InvalidArgument("TerarkZipTableReader::MultiGet()",
+        "bad internal key causing ParseInternalKey() failed");
+      continue;
+    }
+    if (filter_ && !(flag & FlagSkipFilter) &&
+        !filter_->MayMatch(TerarkZipBloomFilter::Hash(fstringOf(item.pikey.user_key)))) {
+      continue;
+    }
+    if (!GetSearchKey(item.pikey.user_key, flag,
+                      &u64_targets[i], &item.searchKey)) {
+      continue;
+    }
+    item.recId = size_t(-1);
+    item.idx = i;
+    batch.push_back(item);
+  }
+  if (batch.empty()) {
+    return;
+  }
+  // sorted keys walk the same index path back to back
+  std::sort(batch.begin(), batch.end(), [](const BatchItem& x, const BatchItem& y) {
+    return x.searchKey < y.searchKey;
+  });
+  {
+    valvec<fstring> keys(batch.size(), valvec_no_init());
+    valvec<size_t> recIds(batch.size(), valvec_no_init());
+    for (size_t i = 0; i < batch.size(); ++i) {
+      keys[i] = batch[i].searchKey;
+    }
+    CountAccess(batch.size());
+    std::shared_ptr<const TerarkIndex> indexPin;
+    GetIndex(&indexPin)->FindBatch(batch.size(), keys.data(), recIds.data());
+    size_t found = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (size_t(-1) != recIds[i]) {
+        batch[found] = batch[i];
+        batch[found].recId = recIds[i];
+        ++found;
+      }
+    }
+    batch.resize(found);
+  }
+  if (batch.empty()) {
+    return;
+  }
+  // fetch values in store order, prefetch type_ and read ahead the store
+  // for the whole batch first
+  std::sort(batch.begin(), batch.end(), [](const BatchItem& x, const BatchItem& y) {
+    return x.recId < y.recId;
+  });
+  auto& type = GetType();
+  valvec<size_t> recIds(batch.size(), valvec_no_init());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    recIds[i] = batch[i].recId;
+    if (type.size()) {
+      PrefetchForRead((const byte_t*)type.data() + recIds[i] / 4);
+    }
+  }
+  ReadAheadRecords(recIds.data(), recIds.size());
+  if (ioPool_ && storeUsePread_ && batch.size() > 1) {
+    // overlap the blocking preads, each key has its own get_context
+    ioPool_->ParallelFor(batch.size(), [&](size_t i) {
+      MY_THREAD_LOCAL(valvec<byte_t>, t_tbuf);
+      auto& item = batch[i];
+      status[item.idx] = GetRecord(global_seqno, ro, item.pikey, item.recId,
+                                   get_context[item.idx], &t_tbuf);
+      if (t_tbuf.capacity() > 512 * 1024) {
+        t_tbuf.clear(); // free large thread local memory
+      }
+    });
+  }
+  else {
+    for (auto& item : batch) {
+      status[item.idx] = GetRecord(global_seqno, ro, item.pikey, item.recId,
+                                   get_context[item.idx], &g_tbuf);
+    }
+  }
+  if (g_tbuf.capacity() > 512 * 1024) {
+    g_tbuf.clear(); // free large thread local memory
+  }
+}
+
+uint64_t TerarkZipSubReader::ApproximateOffsetOf(const Slice& ikey,
+                                                 int flag, bool reverse)
+const {
+  ParsedInternalKey pikey;
+  if (!ParseInternalKey(ikey, &pikey)) {
+    return rawReaderOffset_;
+  }
+  Slice user_key = pikey.user_key;
+#if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
+  uint64_t u64_target;
+  if (flag & FlagUint64Comparator) {
+    assert(pikey.user_key.size() == 8);
+    u64_target = byte_swap(*reinterpret_cast<const uint64_t*>(pikey.user_key.data()));
+    user_key = Slice(reinterpret_cast<const char*>(&u64_target), 8);
+  }
+#else
+  (void)flag;
+#endif
+  assert(user_key.starts_with(prefix_));
+  user_key.remove_prefix(prefix_.size());
+  size_t numKeys = index_->NumKeys();
+  size_t rank;
+  size_t cplen = user_key.difference_offset(commonPrefix_);
+  if (commonPrefix_.size() != cplen) {
+    if (user_key.size() == cplen ||
+        byte_t(user_key[cplen]) < byte_t(commonPrefix_[cplen])) {
+      rank = 0;
+    }
+    else {
+      rank = numKeys;
+    }
+  }
+  else {
+    unique_ptr<TerarkIndex::Iterator> iter(index_->NewIterator());
+    if (iter->Seek(fstringOf(user_key).substr(cplen))) {
+      rank = iter->DictRank();
+    }
+    else {
+      rank = numKeys;
+    }
+  }
+  assert(rank <= numKeys);
+  if (reverse) {
+    rank = numKeys - rank;
+  }
+  // index and value store are both proportional to the key rank
+  return rawReaderOffset_ + uint64_t(double(rawReaderSize_) * rank / numKeys);
 }
 
 TerarkZipSubReader::~TerarkZipSubReader() {
@@ -837,10 +1882,7 @@ TerarkEmptyTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
     if (!s.ok())
       return s;
   }
-  else {
-    return Status::InvalidArgument("TerarkZipTableReader::Open()",
-      "EnvOptions::use_mmap_reads must be true");
-  }
+  // else: empty table has no data, tombstone is read into heap
   if (props->comparator_name != fstring(ioptions.user_comparator->Name())) {
     return Status::InvalidArgument("TerarkZipTableReader::Open()",
       "Invalid user_comparator , need " + props->comparator_name
@@ -861,7 +1903,7 @@ TerarkEmptyTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
 
 
 Status
-TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
+TerarkZipTableReaderBase::OpenFile(RandomAccessFileReader* file, uint64_t file_size) {
   file_.reset(file); // take ownership
   const auto& ioptions = table_reader_options_.ioptions;
   TableProperties* props = nullptr;
@@ -879,8 +1921,19 @@ TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
       return s;
   }
   else {
-    return Status::InvalidArgument("TerarkZipTableReader::Open()",
-      "EnvOptions::use_mmap_reads must be true");
+    if (table_reader_options_.env_options.use_direct_reads &&
+        !table_factory_->cache()) {
+      return Status::InvalidArgument("TerarkZipTableReader::Open()",
+        "EnvOptions::use_direct_reads requires cacheCapacityBytes > 0 "
+        "when EnvOptions::use_mmap_reads is false");
+    }
+    // nothing is mapped, index & dict are loaded into heap, the meta data
+    // of value stores are read into anonData_ by LoadAnonStore, records
+    // are read by pread
+    s = AnonymousAlloc(props->data_size, &file_data);
+    if (!s.ok())
+      return s;
+    anonData_ = file_data;
   }
   if (props->comparator_name != fstring(ioptions.user_comparator->Name())) {
     return Status::InvalidArgument("TerarkZipTableReader::Open()",
@@ -895,12 +1948,24 @@ TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
   isUint64Comparator_ =
     fstring(ioptions.user_comparator->Name()) == "rocksdb.Uint64Comparator";
 #endif
-  BlockContents valueDictBlock, indexBlock, zValueTypeBlock, commonPrefixBlock;
   UpdateCollectInfo(table_factory_, &tzto_, props, file_size);
   s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
-    kTerarkZipTableValueDictBlock, &valueDictBlock);
+    kTerarkZipTableValueDictBlock, &valueDictBlock_);
+  if (auto dictRegistry = table_factory_->dictRegistry()) {
+    // tables sharing a reused dict share its memory
+    if (s.ok() && valueDictBlock_.data.size() > 0) {
+      if (table_reader_options_.env_options.use_mmap_reads) {
+        // the mmap costs no heap, don't copy it if nobody shares it yet
+        sharedDict_ = dictRegistry->Find(fstringOf(valueDictBlock_.data));
+      }
+      else {
+        sharedDict_ = dictRegistry->Intern(fstringOf(valueDictBlock_.data));
+        valueDictBlock_ = BlockContents();
+      }
+    }
+  }
   s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
-    kTerarkZipTableIndexBlock, &indexBlock);
+    kTerarkZipTableIndexBlock, &indexBlock_);
   if (!s.ok()) {
     return s;
   }
@@ -909,69 +1974,446 @@ TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
     global_seqno_ = 0;
   }
   s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
-    kTerarkZipTableCommonPrefixBlock, &commonPrefixBlock);
-  if (s.ok()) {
-    subReader_.commonPrefix_.assign(commonPrefixBlock.data.data(),
-      commonPrefixBlock.data.size());
+    kTerarkZipTableValueTypeBlock, &zValueTypeBlock_);
+  if (!s.ok()) {
+    // all values are kZeroSeq
+    zValueTypeBlock_.data = Slice();
+  }
+  // replicas are copied from the file or heap blocks, each one is on huge
+  // pages by itself, a shared huge page copy would be a N+1th copy
+  const bool numaReplica = tzto_.indexNumaReplica && NumaNodeCount() > 1;
+  if (IndexHugePageMode() && !numaReplica) {
+    s = LoadHugePage();
+    if (!s.ok()) {
+      return s;
+    }
   }
-  else {
-    // some error, usually is
-    // Status::Corruption("Cannot find the meta block", meta_block_name)
+  if (numaReplica) {
+    s = LoadNumaReplicas();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
+    kTerarkZipTableFilterBlock, &filterBlock_);
+  if (s.ok() && !filter_.Init(fstringOf(filterBlock_.data))) {
     WARN(ioptions.info_log
-      , "Read %s block failed, treat as old SST version, error: %s\n"
-      , kTerarkZipTableCommonPrefixBlock.c_str()
-      , s.ToString().c_str());
+      , "TerarkZipTableReader::Open(): bad %s, size = %zd, ignored\n"
+      , kTerarkZipTableFilterBlock.c_str(), filterBlock_.data.size());
+  }
+  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
+    kTerarkZipTableSeqBlock, &seqBlock_);
+  if (!s.ok()) {
+    // seq is stored in value records
+    seqBlock_.data = Slice();
+  }
+  return Status::OK();
+}
+
+int TerarkZipTableReaderBase::IndexHugePageMode() const {
+  // a small index would waste most of the 2MB page, keep it on the mmap
+  size_t size = terark::align_up(indexBlock_.data.size(), 16)
+              + zValueTypeBlock_.data.size();
+  return size < tzto_.indexHugePageMinBytes ? 0 : tzto_.indexHugePage;
+}
+
+Status TerarkZipTableReaderBase::LoadHugePage() {
+  // index and type array are hot in point lookup, blob store offsets are
+  // embedded in the store memory and not relocatable, they are not moved
+  auto info_log = table_reader_options_.ioptions.info_log;
+  size_t indexSize = terark::align_up(indexBlock_.data.size(), 16);
+  size_t typeSize = zValueTypeBlock_.data.size();
+  Status s = HugePageAlloc(indexSize + typeSize, tzto_.indexHugePage,
+    &hugePageData_, info_log);
+  if (!s.ok()) {
+    return s;
+  }
+  char* base = (char*)hugePageData_.data();
+  memcpy(base, indexBlock_.data.data(), indexBlock_.data.size());
+  memcpy(base + indexSize, zValueTypeBlock_.data.data(), typeSize);
+  HugePageSeal(hugePageData_, tzto_.indexMlock, info_log);
+  // heap blocks (use_mmap_reads is false) are no longer needed
+  indexBlock_.allocation.reset();
+  indexBlock_.data = Slice(hugePageData_.data(), indexBlock_.data.size());
+  if (typeSize) {
+    zValueTypeBlock_.allocation.reset();
+    zValueTypeBlock_.data = Slice(hugePageData_.data() + indexSize, typeSize);
+  }
+  return Status::OK();
+}
+
+Status TerarkZipTableReaderBase::LoadNumaReplicas() {
+  // same layout as LoadHugePage, sub readers locate their parts by offset,
+  // indexBlock_ & zValueTypeBlock_ stay on the file or heap
+  auto info_log = table_reader_options_.ioptions.info_log;
+  size_t indexSize = terark::align_up(indexBlock_.data.size(), 16);
+  size_t typeSize = zValueTypeBlock_.data.size();
+  size_t nodes = std::min<size_t>(NumaNodeCount(), 64);
+  for (size_t node = 0; node < nodes; ++node) {
+    Slice mem;
+    Status s = HugePageAlloc(indexSize + typeSize, IndexHugePageMode(),
+      &mem, info_log);
+    if (!s.ok()) {
+      return s;
+    }
+    numaData_.push_back(mem);
+    // bind before the first touch, pages are allocated on memcpy
+    if (!NumaBind(mem, node)) {
+      WARN(info_log
+        , "TerarkZipTableReader::Open(): mbind(node = %zd) = %s, ignored\n"
+        , node, strerror(errno));
+    }
+    char* base = (char*)mem.data();
+    memcpy(base, indexBlock_.data.data(), indexBlock_.data.size());
+    memcpy(base + indexSize, zValueTypeBlock_.data.data(), typeSize);
+    HugePageSeal(mem, tzto_.indexMlock, info_log);
   }
+  return Status::OK();
+}
+
+Status
+TerarkZipTableReaderBase::LoadSubReader(TerarkZipSubReader* part,
+                                        size_t partIndex,
+                                        fstring storeData,
+                                        fstring indexData,
+                                        fstring typeData,
+                                        fstring prefix,
+                                        fstring commonPrefix,
+                                        size_t rawReaderOffset) {
+  part->subIndex_ = partIndex;
+  part->prefix_.assign(prefix.data(), prefix.size());
+  part->commonPrefix_.assign(commonPrefix.data(), commonPrefix.size());
+  auto func = "TerarkZipTableReader::LoadIndex()";
   try {
-    subReader_.store_.reset(terark::BlobStore::load_from_user_memory(
-      fstring(file_data.data(), props->data_size),
-      fstringOf(valueDictBlock.data)
-    ));
+    part->index_ = TerarkIndex::LoadMemory(indexData);
+  }
+  catch (const BadCrc32cException& ex) {
+    return Status::Corruption(func, ex.what());
+  }
+  catch (const std::exception& ex) {
+    return Status::InvalidArgument(func, ex.what());
+  }
+  try {
+    if (anonData_.empty()) {
+      part->store_.reset(terark::BlobStore::load_from_user_memory(
+        storeData, ValueDict()
+      ));
+    }
+    else {
+      Status s = LoadAnonStore(part, storeData);
+      if (!s.ok()) {
+        return s;
+      }
+    }
   }
   catch (const BadCrc32cException& ex) {
     return Status::Corruption("TerarkZipTableReader::Open()", ex.what());
   }
-  s = LoadIndex(indexBlock.data);
+  if (!typeData.empty()) {
+    part->type_.risk_set_data((byte_t*)typeData.data(), part->index_->NumKeys());
+  }
+  if (!numaData_.empty()) {
+    size_t indexOffset = indexData.data() - indexBlock_.data.data();
+    size_t typeOffset = terark::align_up(indexBlock_.data.size(), 16)
+      + (typeData.data() - zValueTypeBlock_.data.data());
+    part->numaReplica_.reset(new TerarkZipSubReader::NumaReplica[numaData_.size()]);
+    for (size_t node = 0; node < numaData_.size(); ++node) {
+      auto& replica = part->numaReplica_[node];
+      const char* base = numaData_[node].data();
+      try {
+        replica.index = TerarkIndex::LoadMemory(
+          fstring(base + indexOffset, indexData.size()));
+      }
+      catch (const std::exception& ex) {
+        return Status::Corruption(func, ex.what());
+      }
+      if (!typeData.empty()) {
+        replica.type.risk_set_data((byte_t*)base + typeOffset,
+                                   part->index_->NumKeys());
+      }
+    }
+    part->numaNodes_ = numaData_.size();
+  }
+  part->filter_ = filter_.Empty() ? nullptr : &filter_;
+  part->valueCache_ = table_factory_->valueCache();
+  if (part->valueCache_) {
+    part->valueCacheId_ = part->valueCache_->NewId();
+  }
+  part->storeFD_ = file_->file()->FileDescriptor();
+  part->storeOffset_ = storeData.data() - file_data_.data();
+  part->InitUsePread(table_reader_options_.env_options.use_mmap_reads
+                     ? tzto_.minPreadLen : 0);
+  part->ioPool_ = table_factory_->ioPool();
+  part->lazyIterValue_ = tzto_.lazyIterValue;
+  part->scanTriggerNext_ = size_t(std::max(tzto_.iterScanTriggerNext, 0));
+  part->rawReaderOffset_ = rawReaderOffset;
+  part->rawReaderSize_ = indexData.size() + storeData.size();
+  return Status::OK();
+}
+
+Status
+TerarkZipTableReaderBase::LoadAnonStore(TerarkZipSubReader* part,
+                                        fstring storeData) {
+  // the store touches only its header and offset array, which is at the
+  // end of the store, the size of offset array is estimated by 8 bytes per
+  // record, if the store is not loadable or its index blocks are out of
+  // the read ranges, the whole store is read
+  size_t storeBegin = storeData.data() - anonData_.data();
+  size_t storeSize = storeData.size();
+  size_t headSize = std::min<size_t>(storeSize, kAnonStoreHeadBytes);
+  size_t tailSize = std::min<size_t>(storeSize - headSize,
+    part->index_->NumKeys() * 8 + kAnonStoreHeadBytes);
+  size_t tailBegin = storeSize - tailSize;
+  Status s = ReadToMemory(file_.get(), anonData_, storeBegin, headSize);
+  if (s.ok()) {
+    s = ReadToMemory(file_.get(), anonData_, storeBegin + tailBegin, tailSize);
+  }
   if (!s.ok()) {
     return s;
   }
-  size_t recNum = subReader_.index_->NumKeys();
-  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
-    kTerarkZipTableValueTypeBlock, &zValueTypeBlock);
-  if (s.ok()) {
-    subReader_.type_.risk_set_data((byte_t*)zValueTypeBlock.data.data(), recNum);
+  anonReadBytes_ += headSize + tailSize;
+  bool covered = false;
+  try {
+    part->store_.reset(terark::BlobStore::load_from_user_memory(
+      storeData, ValueDict()
+    ));
+    covered = true;
+    for (fstring block : part->store_->get_index_blocks()) {
+      size_t beg = block.data() - storeData.data();
+      size_t end = beg + block.size();
+      if (!(end <= headSize || beg >= tailBegin)) {
+        covered = false;
+        break;
+      }
+    }
+  }
+  catch (const std::exception&) {
+    covered = false;
   }
-  subReader_.subIndex_ = 0;
-  subReader_.storeFD_ = file_->file()->FileDescriptor();
-  subReader_.storeOffset_ = 0;
-  subReader_.InitUsePread(tzto_.minPreadLen);
-  subReader_.rawReaderOffset_ = 0;
-  subReader_.rawReaderSize_ = indexBlock.data.size() + props->data_size;
-  if (subReader_.storeUsePread_) {
-    subReader_.cache_ = table_factory_->cache();
-    if (subReader_.cache_) {
-      subReader_.storeFD_ = subReader_.cache_->open(subReader_.storeFD_);
+  if (!covered) {
+    part->store_.reset();
+    s = ReadToMemory(file_.get(), anonData_, storeBegin + headSize,
+                     tailBegin - headSize);
+    if (!s.ok()) {
+      return s;
     }
+    anonReadBytes_ += tailBegin - headSize;
+    part->store_.reset(terark::BlobStore::load_from_user_memory(
+      storeData, ValueDict()
+    ));
   }
-  long long t0 = g_pf.now();
+  return Status::OK();
+}
+
+Status
+TerarkZipTableReaderBase::LoadSeqColumns(TerarkZipSubReader* parts,
+                                         size_t partCount) {
+  fstring mem = fstringOf(seqBlock_.data);
+  if (mem.empty()) {
+    return Status::OK();
+  }
+  for (size_t i = 0; i < partCount; ++i) {
+    size_t used = parts[i].seqColumn_.Init(mem, parts[i].index_->NumKeys());
+    if (0 == used) {
+      return Status::Corruption("TerarkZipTableReader::Open()",
+        "bad " + kTerarkZipTableSeqBlock);
+    }
+    mem = mem.substr(used);
+  }
+  return Status::OK();
+}
+
+void
+TerarkZipTableReaderBase::OpenStoreCache(TerarkZipSubReader* parts,
+                                         size_t partCount) {
+  // all parts share the file, so the cache fd is opened only once
+  for (size_t i = 0; i < partCount; ++i) {
+    auto& part = parts[i];
+    if (!part.storeUsePread_ || !table_factory_->cache()) {
+      continue;
+    }
+    if (!cache_) {
+      cache_ = table_factory_->cache();
+      cacheFD_ = cache_->open(part.storeFD_);
+    }
+    part.cache_ = cache_;
+    part.storeFD_ = cacheFD_;
+  }
+}
+
+void TerarkZipTableReaderBase::WarmUpSubReader(const TerarkZipSubReader& part) {
+  const auto& ioptions = table_reader_options_.ioptions;
+  std::vector<fstring> ranges;
   if (tzto_.warmUpIndexOnOpen) {
-    MmapWarmUp(fstringOf(indexBlock.data));
+    ranges.push_back(part.index_->Memory());
     if (!tzto_.warmUpValueOnOpen) {
-      for (fstring block : subReader_.store_->get_index_blocks()) {
-        MmapWarmUp(block);
+      for (fstring block : part.store_->get_index_blocks()) {
+        ranges.push_back(block);
       }
     }
   }
-  if (tzto_.warmUpValueOnOpen && !subReader_.storeUsePread_) {
-    MmapWarmUp(subReader_.store_->get_mmap());
+  if (tzto_.warmUpValueOnOpen && !part.storeUsePread_) {
+    ranges.push_back(part.store_->get_mmap());
   } else {
-    //MmapColdize(subReader_.store_->get_mmap());
+    //MmapColdize(part.store_->get_mmap());
     if (tzto_.adviseRandomRead || ioptions.advise_random_on_open) {
-      MmapAdviseRandom(subReader_.store_->get_mmap());
+      MmapAdviseRandom(part.store_->get_mmap());
+    }
+  }
+  if (auto pool = table_factory_->warmUpPool()) {
+    // table is usable now, pages are populated in background
+    pool->Submit(this, ranges);
+  } else {
+    for (fstring mem : ranges) {
+      MmapWarmUp(mem);
     }
   }
+}
+
+void TerarkZipTableReaderBase::LogWarmUpProgress() const {
+  if (auto pool = table_factory_->warmUpPool()) {
+    INFO(table_reader_options_.ioptions.info_log
+      , "TerarkZipTable warm up: queued = %.3fGB, warmed = %.3fGB, sync = %.3fGB, skipped = %.3fGB, pending chunks = %zd\n"
+      , pool->QueuedBytes() / 1e9
+      , pool->WarmedBytes() / 1e9
+      , pool->SyncBytes() / 1e9
+      , pool->SkippedBytes() / 1e9
+      , pool->PendingTasks()
+    );
+  }
+}
+
+void TerarkZipTableReaderBase::RegisterIndexCache(TerarkZipSubReader* parts,
+                                                  size_t partCount) {
+  auto manager = table_factory_->indexCacheManager();
+  if (!manager || tzto_.indexCacheRatio > 0) {
+    return; // disabled, or static cache is already built
+  }
+  for (size_t i = 0; i < partCount; ++i) {
+    if (parts[i].numaNodes_) {
+      return; // replicas are not cached
+    }
+  }
+  indexCacheParts_ = parts;
+  indexCachePartCount_ = partCount;
+  for (size_t i = 0; i < partCount; ++i) {
+    parts[i].countAccess_ = true;
+    manager->Register(&parts[i]);
+  }
+}
+
+void TerarkZipTableReaderBase::UnregisterIndexCache() {
+  for (size_t i = 0; i < indexCachePartCount_; ++i) {
+    table_factory_->indexCacheManager()->Unregister(&indexCacheParts_[i]);
+  }
+  indexCachePartCount_ = 0;
+}
+
+void TerarkZipTableReaderBase::CancelWarmUp() {
+  if (auto pool = table_factory_->warmUpPool()) {
+    pool->Cancel(this);
+  }
+}
+
+int TerarkZipTableReaderBase::GetReadFlag(bool skip_filters) const {
+  int flag = skip_filters ? TerarkZipSubReader::FlagSkipFilter : TerarkZipSubReader::FlagNone;
+#if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
+  if (isUint64Comparator_) {
+    flag |= TerarkZipSubReader::FlagUint64Comparator;
+  }
+#endif
+  return flag;
+}
+
+size_t TerarkZipTableReaderBase::ApproximateMemoryUsage() const {
+  size_t numaDataSize = 0;
+  for (auto& mem : numaData_) {
+    numaDataSize += mem.size();
+  }
+  if (anonData_.empty()) {
+    return file_data_.size() + hugePageData_.size() + numaDataSize;
+  }
+  // values are read by pread, only heap loaded blocks and store meta data
+  // are resident
+  return indexBlock_.data.size() + ValueDict().size()
+       + zValueTypeBlock_.data.size() + filterBlock_.data.size()
+       + seqBlock_.data.size() + anonReadBytes_ + numaDataSize;
+}
+
+TerarkZipTableReaderBase::~TerarkZipTableReaderBase() {
+  // sub readers of derived classes are already destroyed here
+  if (cache_) {
+    cache_->close(cacheFD_);
+  }
+  if (!anonData_.empty()) {
+    MunmapReadonly(anonData_);
+  }
+  if (!hugePageData_.empty()) {
+    MunmapReadonly(hugePageData_);
+  }
+  for (auto& mem : numaData_) {
+    MunmapReadonly(mem);
+  }
+}
+
+TerarkZipTableReaderBase::TerarkZipTableReaderBase(const TerarkZipTableFactory* table_factory,
+                                                   const TableReaderOptions& tro,
+                                                   const TerarkZipTableOptions& tzto)
+  : table_reader_options_(tro)
+  , table_factory_(table_factory)
+  , global_seqno_(kDisableGlobalSequenceNumber)
+  , tzto_(tzto)
+  , cache_(nullptr)
+  , cacheFD_(-1)
+{
+  isReverseBytewiseOrder_ = false;
+#if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
+  isUint64Comparator_ = false;
+#endif
+}
+
+
+Status
+TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
+  Status s = OpenFile(file, file_size);
+  if (!s.ok()) {
+    return s;
+  }
+  const auto& ioptions = table_reader_options_.ioptions;
+  auto props = table_properties_.get();
+  BlockContents commonPrefixBlock;
+  fstring commonPrefix;
+  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
+    kTerarkZipTableCommonPrefixBlock, &commonPrefixBlock);
+  if (s.ok()) {
+    commonPrefix = fstringOf(commonPrefixBlock.data);
+  }
+  else {
+    // some error, usually is
+    // Status::Corruption("Cannot find the meta block", meta_block_name)
+    WARN(ioptions.info_log
+      , "Read %s block failed, treat as old SST version, error: %s\n"
+      , kTerarkZipTableCommonPrefixBlock.c_str()
+      , s.ToString().c_str());
+  }
+  s = LoadSubReader(&subReader_, 0,
+    fstring(file_data_.data(), props->data_size),
+    fstringOf(indexBlock_.data),
+    fstringOf(zValueTypeBlock_.data),
+    fstring(), commonPrefix, 0);
+  if (!s.ok()) {
+    return s;
+  }
+  s = LoadSeqColumns(&subReader_, 1);
+  if (!s.ok()) {
+    return s;
+  }
+  OpenStoreCache(&subReader_, 1);
+  long long t0 = g_pf.now();
+  WarmUpSubReader(subReader_);
   long long t1 = g_pf.now();
-  subReader_.index_->BuildCache(tzto_.indexCacheRatio);
+  subReader_.BuildCache(tzto_.indexCacheRatio);
+  RegisterIndexCache(&subReader_, 1);
   long long t2 = g_pf.now();
   INFO(ioptions.info_log
     , "TerarkZipTableReader::Open(): fsize = %zd, entries = %zd keys = %zd indexSize = %zd valueSize=%zd, warm up time = %6.3f'sec, build cache time = %6.3f'sec\n"
@@ -982,57 +2424,42 @@ TerarkZipTableReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
     , g_pf.sf(t0, t1)
     , g_pf.sf(t1, t2)
   );
+  LogWarmUpProgress();
   return Status::OK();
 }
 
-
-
-Status TerarkZipTableReader::LoadIndex(Slice mem) {
-  auto func = "TerarkZipTableReader::LoadIndex()";
-  try {
-    subReader_.index_ = TerarkIndex::LoadMemory(fstringOf(mem));
-  }
-  catch (const BadCrc32cException& ex) {
-    return Status::Corruption(func, ex.what());
+template<class Iter, class Source>
+static InternalIterator*
+NewIteratorOnArena(Arena* arena, const TableReaderOptions& tro,
+                   const Source& source, const ReadOptions& ro,
+                   SequenceNumber global_seqno) {
+  if (arena) {
+    return new(arena->AllocateAligned(sizeof(Iter)))
+      Iter(tro, source, ro, global_seqno);
   }
-  catch (const std::exception& ex) {
-    return Status::InvalidArgument(func, ex.what());
+  else {
+    return new Iter(tro, source, ro, global_seqno);
   }
-  return Status::OK();
 }
 
 InternalIterator*
 TerarkZipTableReader::
 NewIterator(const ReadOptions& ro, Arena* arena, bool skip_filters) {
   (void)skip_filters; // unused
+  const TerarkZipSubReader* subReader = &subReader_;
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
   if (isUint64Comparator_) {
-    if (arena) {
-      return new(arena->AllocateAligned(sizeof(TerarkZipTableUint64Iterator)))
-        TerarkZipTableUint64Iterator(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
-    else {
-      return new TerarkZipTableUint64Iterator(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
+    return NewIteratorOnArena<TerarkZipTableUint64Iterator>(arena,
+      table_reader_options_, subReader, ro, global_seqno_);
   }
 #endif
   if (isReverseBytewiseOrder_) {
-    if (arena) {
-      return new(arena->AllocateAligned(sizeof(TerarkZipTableIterator<true>)))
-        TerarkZipTableIterator<true>(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
-    else {
-      return new TerarkZipTableIterator<true>(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
+    return NewIteratorOnArena<TerarkZipTableIterator<true> >(arena,
+      table_reader_options_, subReader, ro, global_seqno_);
   }
   else {
-    if (arena) {
-      return new(arena->AllocateAligned(sizeof(TerarkZipTableIterator<false>)))
-        TerarkZipTableIterator<false>(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
-    else {
-      return new TerarkZipTableIterator<false>(table_reader_options_, &subReader_, ro, global_seqno_);
-    }
+    return NewIteratorOnArena<TerarkZipTableIterator<false> >(arena,
+      table_reader_options_, subReader, ro, global_seqno_);
   }
 }
 
@@ -1040,36 +2467,309 @@ NewIterator(const ReadOptions& ro, Arena* arena, bool skip_filters) {
 Status
 TerarkZipTableReader::Get(const ReadOptions& ro, const Slice& ikey,
                           GetContext* get_context, bool skip_filters) {
-  int flag = skip_filters ? TerarkZipSubReader::FlagSkipFilter : TerarkZipSubReader::FlagNone;
-#if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
-  if (isUint64Comparator_) {
-    flag |= TerarkZipSubReader::FlagUint64Comparator;
-  }
-#endif
+  int flag = GetReadFlag(skip_filters);
   return subReader_.Get(global_seqno_, ro, ikey, get_context, flag);
 }
 
+void
+TerarkZipTableReader::MultiGet(const ReadOptions& ro, size_t num,
+                               const Slice* ikeys, GetContext** get_context,
+                               Status* status, bool skip_filters) {
+  int flag = GetReadFlag(skip_filters);
+  subReader_.MultiGet(global_seqno_, ro, num, ikeys, get_context, status, flag);
+}
+
 uint64_t TerarkZipTableReader::ApproximateOffsetOf(const Slice& ikey) {
-  return 0;
+  int flag = GetReadFlag(false);
+  return subReader_.ApproximateOffsetOf(ikey, flag, isReverseBytewiseOrder_);
 }
 
 TerarkZipTableReader::~TerarkZipTableReader() {
-  if (subReader_.storeUsePread_) {
-    if (subReader_.cache_) {
-      subReader_.cache_->close(subReader_.storeFD_);
-    }
-  }
+  CancelWarmUp(); // background warm up may still read subReader_
+  UnregisterIndexCache();
 }
 
 TerarkZipTableReader::TerarkZipTableReader(const TerarkZipTableFactory* table_factory,
                                            const TableReaderOptions& tro,
                                            const TerarkZipTableOptions& tzto)
-  : table_reader_options_(tro)
-  , table_factory_(table_factory)
-  , global_seqno_(kDisableGlobalSequenceNumber)
-  , tzto_(tzto)
+  : TerarkZipTableReaderBase(table_factory, tro, tzto)
 {
-  isReverseBytewiseOrder_ = false;
+}
+
+
+TerarkZipTableMultiReader::SubIndex::SubIndex()
+  : partCount_(0)
+  , prefixLen_(0)
+  , isReverse_(false) {
+}
+
+TerarkZipTableMultiReader::SubIndex::~SubIndex() {
+}
+
+void TerarkZipTableMultiReader::SubIndex::Init(
+      const TerarkZipMultiOffsetInfo& offsetInfo, bool reverse) {
+  partCount_ = offsetInfo.partCount_;
+  prefixLen_ = offsetInfo.prefixLen_;
+  isReverse_ = reverse;
+  prefixSet_ = fstring(offsetInfo.prefixSet_.data(), offsetInfo.prefixSet_.size());
+  subReader_.reset(new TerarkZipSubReader[partCount_]);
+}
+
+fstring TerarkZipTableMultiReader::SubIndex::GetPrefix(size_t i) const {
+  assert(i < partCount_);
+  return fstring(prefixSet_.data() + i * prefixLen_, prefixLen_);
+}
+
+TerarkZipSubReader*
+TerarkZipTableMultiReader::SubIndex::GetSubReader(size_t i) const {
+  assert(i < partCount_);
+  return &subReader_[i];
+}
+
+size_t TerarkZipTableMultiReader::SubIndex::LowerBound(fstring userKey) const {
+  // parts are sorted by prefix in table order
+  fstring key = userKey.substr(0, std::min(userKey.size(), prefixLen_));
+  size_t lo = 0, hi = partCount_;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    fstring prefix = GetPrefix(mid);
+    if (isReverse_ ? key < prefix : prefix < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+const TerarkZipSubReader*
+TerarkZipTableMultiReader::SubIndex::GetSubReader(fstring userKey) const {
+  size_t i = LowerBound(userKey);
+  if (i < partCount_ && userKey.startsWith(GetPrefix(i))) {
+    return &subReader_[i];
+  }
+  return nullptr;
+}
+
+Status
+TerarkZipTableMultiReader::Open(RandomAccessFileReader* file, uint64_t file_size) {
+  Status s = OpenFile(file, file_size);
+  if (!s.ok()) {
+    return s;
+  }
+  const auto& ioptions = table_reader_options_.ioptions;
+  auto props = table_properties_.get();
+  BlockContents commonPrefixBlock;
+  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
+    kTerarkZipTableCommonPrefixBlock, &commonPrefixBlock);
+  if (!s.ok()) {
+    return s;
+  }
+  s = ReadMetaBlockAdapte(file, file_size, kTerarkZipTableMagicNumber, ioptions,
+    kTerarkZipTableOffsetBlock, &offsetBlock_);
+  if (!s.ok()) {
+    return s;
+  }
+  TerarkZipMultiOffsetInfo offsetInfo;
+  if (!offsetInfo.risk_set_memory(offsetBlock_.data.data(), offsetBlock_.data.size())) {
+    return Status::Corruption("TerarkZipTableMultiReader::Open()",
+      "bad " + kTerarkZipTableOffsetBlock);
+  }
+  auto loadParts = [&]() -> Status {
+    const size_t partCount = offsetInfo.partCount_;
+    const size_t prefixLen = offsetInfo.prefixLen_;
+    if (0 == partCount) {
+      return Status::Corruption("TerarkZipTableMultiReader::Open()",
+        "empty " + kTerarkZipTableOffsetBlock);
+    }
+    auto& last = offsetInfo.offset_[partCount - 1];
+    if (last.key != indexBlock_.data.size() ||
+        last.value != props->data_size ||
+        last.type != zValueTypeBlock_.data.size() ||
+        last.commonPrefix != commonPrefixBlock.data.size()) {
+      return Status::Corruption("TerarkZipTableMultiReader::Open()",
+        "part offsets mismatch with blocks");
+    }
+    subIndex_.Init(offsetInfo, isReverseBytewiseOrder_);
+    TerarkZipMultiOffsetInfo::KeyValueOffset prev = { 0, 0, 0, 0 };
+    size_t rawReaderOffset = 0;
+    for (size_t i = 0; i < partCount; ++i) {
+      auto& curr = offsetInfo.offset_[i];
+      if (curr.key < prev.key || curr.value < prev.value ||
+          curr.type < prev.type ||
+          curr.commonPrefix < prev.commonPrefix + prefixLen) {
+        return Status::Corruption("TerarkZipTableMultiReader::Open()",
+          "part offsets are not ascending");
+      }
+      fstring storeData(file_data_.data() + prev.value, curr.value - prev.value);
+      fstring indexData(indexBlock_.data.data() + prev.key, curr.key - prev.key);
+      fstring typeData(zValueTypeBlock_.data.data() + prev.type, curr.type - prev.type);
+      // commonPrefix of each part is stored with its prefix
+      fstring commonPrefix(commonPrefixBlock.data.data() + prev.commonPrefix,
+                           curr.commonPrefix - prev.commonPrefix);
+      s = LoadSubReader(subIndex_.GetSubReader(i), i,
+        storeData, indexData, typeData,
+        subIndex_.GetPrefix(i), commonPrefix.substr(prefixLen),
+        rawReaderOffset);
+      if (!s.ok()) {
+        return s;
+      }
+      rawReaderOffset += storeData.size() + indexData.size();
+      prev = curr;
+    }
+    return Status::OK();
+  };
+  s = loadParts();
+  offsetInfo.risk_release_ownership();
+  if (!s.ok()) {
+    return s;
+  }
+  const size_t partCount = subIndex_.GetPartCount();
+  s = LoadSeqColumns(subIndex_.GetSubReader(0), partCount);
+  if (!s.ok()) {
+    return s;
+  }
+  OpenStoreCache(subIndex_.GetSubReader(0), partCount);
+  size_t numKeys = 0;
+  long long t0 = g_pf.now();
+  for (size_t i = 0; i < partCount; ++i) {
+    WarmUpSubReader(*subIndex_.GetSubReader(i));
+  }
+  long long t1 = g_pf.now();
+  for (size_t i = 0; i < partCount; ++i) {
+    auto part = subIndex_.GetSubReader(i);
+    part->BuildCache(tzto_.indexCacheRatio);
+    numKeys += part->index_->NumKeys();
+  }
+  RegisterIndexCache(subIndex_.GetSubReader(0), partCount);
+  long long t2 = g_pf.now();
+  INFO(ioptions.info_log
+    , "TerarkZipTableMultiReader::Open(): fsize = %zd, entries = %zd keys = %zd parts = %zd indexSize = %zd valueSize=%zd, warm up time = %6.3f'sec, build cache time = %6.3f'sec\n"
+    , size_t(file_size), size_t(props->num_entries)
+    , numKeys, partCount
+    , size_t(props->index_size)
+    , size_t(props->data_size)
+    , g_pf.sf(t0, t1)
+    , g_pf.sf(t1, t2)
+  );
+  LogWarmUpProgress();
+  return Status::OK();
+}
+
+InternalIterator*
+TerarkZipTableMultiReader::
+NewIterator(const ReadOptions& ro, Arena* arena, bool skip_filters) {
+  (void)skip_filters; // unused
+  if (isReverseBytewiseOrder_) {
+    return NewIteratorOnArena<TerarkZipTableMultiIterator<true> >(arena,
+      table_reader_options_, subIndex_, ro, global_seqno_);
+  }
+  else {
+    return NewIteratorOnArena<TerarkZipTableMultiIterator<false> >(arena,
+      table_reader_options_, subIndex_, ro, global_seqno_);
+  }
+}
+
+Status
+TerarkZipTableMultiReader::Get(const ReadOptions& ro, const Slice& ikey,
+                               GetContext* get_context, bool skip_filters) {
+  if (ikey.size() < kNumInternalBytes) {
+    return Status::InvalidArgument("TerarkZipTableMultiReader::Get()",
+      "bad internal key causing ParseInternalKey() failed");
+  }
+  auto subReader = subIndex_.GetSubReader(fstringOf(ExtractUserKey(ikey)));
+  if (subReader == nullptr) {
+    return Status::OK();
+  }
+  int flag = GetReadFlag(skip_filters);
+  return subReader->Get(global_seqno_, ro, ikey, get_context, flag);
+}
+
+void
+TerarkZipTableMultiReader::MultiGet(const ReadOptions& ro, size_t num,
+                                    const Slice* ikeys, GetContext** get_context,
+                                    Status* status, bool skip_filters) {
+  int flag = GetReadFlag(skip_filters);
+  // {partIndex, keyIndex}, keys of one part are passed to its sub reader
+  std::vector<std::pair<size_t, size_t> > batch;
+  batch.reserve(num);
+  for (size_t i = 0; i < num; ++i) {
+    status[i] = Status::OK();
+    if (ikeys[i].size() < kNumInternalBytes) {
+      status[i] = Status::InvalidArgument("TerarkZipTableMultiReader::MultiGet()",
+        "bad internal key causing ParseInternalKey() failed");
+      continue;
+    }
+    fstring userKey = fstringOf(ExtractUserKey(ikeys[i]));
+    size_t partIndex = subIndex_.LowerBound(userKey);
+    if (partIndex < subIndex_.GetPartCount() &&
+        userKey.startsWith(subIndex_.GetPrefix(partIndex))) {
+      batch.emplace_back(partIndex, i);
+    }
+  }
+  std::sort(batch.begin(), batch.end());
+  std::vector<Slice> partKeys;
+  std::vector<GetContext*> partContext;
+  std::vector<Status> partStatus;
+  for (size_t beg = 0, end; beg < batch.size(); beg = end) {
+    size_t partIndex = batch[beg].first;
+    for (end = beg + 1; end < batch.size() && batch[end].first == partIndex; ) {
+      ++end;
+    }
+    partKeys.clear();
+    partContext.clear();
+    for (size_t j = beg; j < end; ++j) {
+      partKeys.push_back(ikeys[batch[j].second]);
+      partContext.push_back(get_context[batch[j].second]);
+    }
+    partStatus.resize(end - beg);
+    subIndex_.GetSubReader(partIndex)->MultiGet(global_seqno_, ro, end - beg,
+      partKeys.data(), partContext.data(), partStatus.data(), flag);
+    for (size_t j = beg; j < end; ++j) {
+      status[batch[j].second] = std::move(partStatus[j - beg]);
+    }
+  }
+}
+
+uint64_t TerarkZipTableMultiReader::ApproximateOffsetOf(const Slice& ikey) {
+  if (ikey.size() < kNumInternalBytes) {
+    return 0;
+  }
+  fstring userKey = fstringOf(ExtractUserKey(ikey));
+  size_t partIndex = subIndex_.LowerBound(userKey);
+  if (partIndex == subIndex_.GetPartCount()) {
+    auto part = subIndex_.GetSubReader(partIndex - 1);
+    return part->rawReaderOffset_ + part->rawReaderSize_;
+  }
+  auto part = subIndex_.GetSubReader(partIndex);
+  if (!userKey.startsWith(subIndex_.GetPrefix(partIndex))) {
+    return part->rawReaderOffset_;
+  }
+  int flag = GetReadFlag(false);
+  return part->ApproximateOffsetOf(ikey, flag, isReverseBytewiseOrder_);
+}
+
+TerarkZipTableMultiReader::~TerarkZipTableMultiReader() {
+  CancelWarmUp(); // background warm up may still read subIndex_
+  UnregisterIndexCache();
+}
+
+TerarkZipTableMultiReader::TerarkZipTableMultiReader(const TerarkZipTableFactory* table_factory,
+                                                     const TableReaderOptions& tro,
+                                                     const TerarkZipTableOptions& tzto)
+  : TerarkZipTableReaderBase(table_factory, tro, tzto)
+{
+}
+
+bool TerarkZipTableMultiGet(TableReader* reader, const ReadOptions& ro,
+                            size_t num, const Slice* ikeys,
+                            GetContext** get_context, Status* status,
+                            bool skip_filters) {
+  auto tztr = dynamic_cast<TerarkZipTableReaderBase*>(reader);
+  if (tztr == nullptr) {
+    return false;
+  }
+  tztr->MultiGet(ro, num, ikeys, get_context, status, skip_filters);
+  return true;
 }
 
 
@@ -15,6 +15,7 @@
 #include "terark_zip_table.h"
 #include "terark_zip_internal.h"
 #include "terark_zip_index.h"
+#include "terark_zip_filter.h"
 // boost headers
 #include <boost/noncopyable.hpp>
 // rocksdb headers
@@ -129,6 +130,30 @@ struct TerarkZipSubReader {
   unique_ptr<terark::BlobStore> store_;
   bitfield_array<2> type_;
   std::string commonPrefix_;
+  const TerarkZipBloomFilter* filter_ = nullptr; // shared by all parts
+  Cache* valueCache_ = nullptr;
+  uint64_t valueCacheId_ = 0; // unique key prefix in valueCache_
+  TerarkZipIoPool* ioPool_ = nullptr; // MultiGet & scan lookahead pread
+  bool lazyIterValue_ = false;
+  size_t scanTriggerNext_ = 0; // 0: scan mode only by readahead_size
+  // seq of kValue & kDelete, records have no seq header if not Empty()
+  TerarkZipSeqColumn seqColumn_;
+
+  // per NUMA node copy of index_ & type_, see indexNumaReplica
+  struct NumaReplica {
+    unique_ptr<TerarkIndex> index;
+    bitfield_array<2> type;
+    ~NumaReplica() { type.risk_release_ownership(); }
+  };
+  std::unique_ptr<NumaReplica[]> numaReplica_;
+  size_t numaNodes_ = 0;
+
+  // index_ with fsa cache, published and evicted by
+  // TerarkZipIndexCacheManager, cachedIndexHolder_ is accessed atomically
+  std::atomic<const TerarkIndex*> cachedIndex_{nullptr};
+  std::shared_ptr<const TerarkIndex> cachedIndexHolder_;
+  mutable std::atomic<uint64_t> accessCount_{0}; // sampled lookups
+  bool countAccess_ = false;
 
   enum {
     FlagNone = 0,
@@ -140,50 +165,78 @@ struct TerarkZipSubReader {
 
   void InitUsePread(int minPreadLen);
 
-  void GetRecordAppend(size_t recId, valvec<byte_t>* tbuf, uint32_t offset, uint32_t length) const;
-  void GetRecordAppend(size_t recId, valvec<byte_t>* tbuf) const;
+  // the cached index if any, pin holds it alive while it is in use, it
+  // may be evicted at any time, else the replica on the NUMA node of
+  // calling thread, or index_
+  const TerarkIndex* GetIndex(std::shared_ptr<const TerarkIndex>* pin) const;
+  const TerarkIndex* GetUncachedIndex() const;
+  TerarkIndex::Iterator*
+  NewIndexIterator(std::shared_ptr<const TerarkIndex>* pin) const;
+  const bitfield_array<2>& GetType() const;
+  void BuildCache(double cacheRatio);
+  void CountAccess(size_t n) const;
+  // MADV_WILLNEED on the estimated store range of records, mmap only
+  void ReadAheadRecords(const size_t* recIds, size_t num) const;
+
+  // append record[0, headerLen) and record[headerLen + offset, +length)
+  void GetRecordAppend(size_t recId, valvec<byte_t>* tbuf, size_t headerLen,
+                       uint32_t offset, uint32_t length, bool fillCache) const;
+  void GetRecordAppend(size_t recId, valvec<byte_t>* tbuf, bool fillCache) const;
+  // append 7 bytes little endian seq of kValue or kDelete record, with
+  // capacity for 8, the value cache is never filled by it
+  void GetSeqHeaderAppend(size_t recId, valvec<byte_t>* tbuf) const;
+
+  bool GetSearchKey(const Slice& user_key, int flag,
+    uint64_t* u64_buf, fstring* search_key) const;
+
+  Status GetRecord(SequenceNumber, const ReadOptions&,
+    const ParsedInternalKey&, size_t recId,
+    GetContext*, valvec<byte_t>* tbuf) const;
 
   Status Get(SequenceNumber, const ReadOptions&, const Slice& key,
     GetContext*, int flag) const;
 
+  void MultiGet(SequenceNumber, const ReadOptions&, size_t num,
+    const Slice* keys, GetContext** get_context, Status* status,
+    int flag) const;
+
+  uint64_t ApproximateOffsetOf(const Slice& key, int flag, bool reverse) const;
+
   ~TerarkZipSubReader();
 };
 
 /**
- * one user key map to a record id: the index NO. of a key in NestLoudsTrie,
- * the record id is used to direct index a type enum(small integer) array,
- * the record id is also used to access the value store
+ * common part of TerarkZipTableReader and TerarkZipTableMultiReader:
+ * table properties, file mapping, shared meta blocks and pread cache
  */
-class TerarkZipTableReader
+class TerarkZipTableReaderBase
   : public TerarkZipTableTombstone
   , public TableReader
   , boost::noncopyable {
 public:
-  InternalIterator*
-    NewIterator(const ReadOptions&, Arena*, bool skip_filters) override;
-
   using TerarkZipTableTombstone::NewRangeTombstoneIterator;
 
   void Prepare(const Slice& target) override {}
 
-  Status Get(const ReadOptions&, const Slice& key, GetContext*,
-    bool skip_filters) override;
-
-  uint64_t ApproximateOffsetOf(const Slice& key) override;
   void SetupForCompaction() override {}
 
   std::shared_ptr<const TableProperties>
     GetTableProperties() const override { return table_properties_; }
 
-  size_t ApproximateMemoryUsage() const override { return file_data_.size(); }
+  size_t ApproximateMemoryUsage() const override;
 
-  virtual ~TerarkZipTableReader();
-  TerarkZipTableReader(const TerarkZipTableFactory* table_factory, 
-                       const TableReaderOptions&,
-                       const TerarkZipTableOptions&);
-  Status Open(RandomAccessFileReader* file, uint64_t file_size);
+  /// batched Get, status[i] is the result of get_context[i] for keys[i],
+  /// not a TableReader virtual, see TerarkZipTableMultiGet
+  virtual void MultiGet(const ReadOptions&, size_t num, const Slice* keys,
+    GetContext** get_context, Status* status, bool skip_filters) = 0;
+
+  virtual ~TerarkZipTableReaderBase();
+
+protected:
+  TerarkZipTableReaderBase(const TerarkZipTableFactory* table_factory,
+                           const TableReaderOptions&,
+                           const TerarkZipTableOptions&);
 
-private:
   SequenceNumber GetSequenceNumber() const override {
     return global_seqno_;
   }
@@ -191,22 +244,144 @@ private:
     return table_reader_options_;
   }
 
-  TerarkZipSubReader subReader_;
+  int GetReadFlag(bool skip_filters) const;
+
+  // load properties, map file data, load the blocks shared by all parts
+  Status OpenFile(RandomAccessFileReader* file, uint64_t file_size);
+  // move index & type array to huge pages, see indexHugePage
+  // tzto_.indexHugePage, or 0 if index & type array is too small
+  int IndexHugePageMode() const;
+  Status LoadHugePage();
+  Status LoadNumaReplicas();
+  Status LoadSubReader(TerarkZipSubReader* part, size_t partIndex,
+    fstring storeData, fstring indexData, fstring typeData,
+    fstring prefix, fstring commonPrefix, size_t rawReaderOffset);
+  void OpenStoreCache(TerarkZipSubReader* parts, size_t partCount);
+  Status LoadSeqColumns(TerarkZipSubReader* parts, size_t partCount);
+  // load the store from anonData_, read only the parts it needs
+  Status LoadAnonStore(TerarkZipSubReader* part, fstring storeData);
+  void WarmUpSubReader(const TerarkZipSubReader& part);
+  // must be called before the memory of sub readers is released
+  void CancelWarmUp();
+  // adaptive index cache, see indexCacheAdaptiveBytes
+  void RegisterIndexCache(TerarkZipSubReader* parts, size_t partCount);
+  void UnregisterIndexCache();
+  void LogWarmUpProgress() const;
+  fstring ValueDict() const {
+    return sharedDict_ ? fstring((const char*)sharedDict_->data(), sharedDict_->size())
+                       : fstringOf(valueDictBlock_.data);
+  }
+
+  // blocks are owned here when EnvOptions::use_mmap_reads is false,
+  // they must outlive sub readers of derived classes
+  BlockContents valueDictBlock_;
+  std::shared_ptr<const valvec<byte_t> > sharedDict_; // see dictReuseTables
+  BlockContents indexBlock_;
+  BlockContents zValueTypeBlock_;
+  BlockContents filterBlock_;
+  BlockContents seqBlock_;
+  TerarkZipBloomFilter filter_;
   static const size_t kNumInternalBytes = 8;
   Slice  file_data_;
+  Slice  anonData_; // store meta data when use_mmap_reads is false
+  size_t anonReadBytes_ = 0; // read into anonData_
+  enum { kAnonStoreHeadBytes = 64 * 1024 };
+  Slice  hugePageData_; // index & type array copy, see indexHugePage
+  std::vector<Slice> numaData_; // index & type array copy per NUMA node
   unique_ptr<RandomAccessFileReader> file_;
   const TableReaderOptions table_reader_options_;
   const TerarkZipTableFactory* table_factory_;
   std::shared_ptr<const TableProperties> table_properties_;
   SequenceNumber global_seqno_;
   const TerarkZipTableOptions& tzto_;
+  LruReadonlyCache* cache_;
+  intptr_t cacheFD_;
+  TerarkZipSubReader* indexCacheParts_ = nullptr;
+  size_t indexCachePartCount_ = 0;
   bool isReverseBytewiseOrder_;
 #if defined(TERARK_SUPPORT_UINT64_COMPARATOR) && BOOST_ENDIAN_LITTLE_BYTE
   bool isUint64Comparator_;
 #endif
-  Status LoadIndex(Slice mem);
 };
 
+/**
+ * one user key map to a record id: the index NO. of a key in NestLoudsTrie,
+ * the record id is used to direct index a type enum(small integer) array,
+ * the record id is also used to access the value store
+ */
+class TerarkZipTableReader : public TerarkZipTableReaderBase {
+public:
+  InternalIterator*
+    NewIterator(const ReadOptions&, Arena*, bool skip_filters) override;
+
+  Status Get(const ReadOptions&, const Slice& key, GetContext*,
+    bool skip_filters) override;
+
+  void MultiGet(const ReadOptions&, size_t num, const Slice* keys,
+    GetContext** get_context, Status* status, bool skip_filters) override;
+
+  uint64_t ApproximateOffsetOf(const Slice& key) override;
+
+  virtual ~TerarkZipTableReader();
+  TerarkZipTableReader(const TerarkZipTableFactory* table_factory,
+                       const TableReaderOptions&,
+                       const TerarkZipTableOptions&);
+  Status Open(RandomAccessFileReader* file, uint64_t file_size);
+
+private:
+  TerarkZipSubReader subReader_;
+};
+
+/**
+ * table built with keyPrefixLen > 0 has one part per key prefix,
+ * each part has its own index, value store, type array and common prefix,
+ * TerarkZipMultiOffsetInfo records the part boundaries in each block
+ */
+class TerarkZipTableMultiReader : public TerarkZipTableReaderBase {
+public:
+  class SubIndex {
+    size_t partCount_;
+    size_t prefixLen_;
+    bool   isReverse_;
+    fstring prefixSet_;
+    std::unique_ptr<TerarkZipSubReader[]> subReader_;
+
+  public:
+    SubIndex();
+    ~SubIndex();
+
+    void Init(const TerarkZipMultiOffsetInfo& offsetInfo, bool reverse);
+    size_t GetPartCount() const { return partCount_; }
+    size_t GetPrefixLen() const { return prefixLen_; }
+    fstring GetPrefix(size_t i) const;
+    TerarkZipSubReader* GetSubReader(size_t i) const;
+    // first part (in table order) which may contain keys >= key prefix
+    size_t LowerBound(fstring userKey) const;
+    // the part with same prefix as userKey, nullptr if not exists
+    const TerarkZipSubReader* GetSubReader(fstring userKey) const;
+  };
+
+  InternalIterator*
+    NewIterator(const ReadOptions&, Arena*, bool skip_filters) override;
+
+  Status Get(const ReadOptions&, const Slice& key, GetContext*,
+    bool skip_filters) override;
+
+  void MultiGet(const ReadOptions&, size_t num, const Slice* keys,
+    GetContext** get_context, Status* status, bool skip_filters) override;
+
+  uint64_t ApproximateOffsetOf(const Slice& key) override;
+
+  virtual ~TerarkZipTableMultiReader();
+  TerarkZipTableMultiReader(const TerarkZipTableFactory* table_factory,
+                            const TableReaderOptions&,
+                            const TerarkZipTableOptions&);
+  Status Open(RandomAccessFileReader* file, uint64_t file_size);
+
+private:
+  BlockContents offsetBlock_;
+  SubIndex subIndex_;
+};
 
 
 }  // namespace rocksdb
@@ -0,0 +1,127 @@
+// project headers
+#include "terark_zip_warmup.h"
+// std headers
+#include <algorithm>
+#include <assert.h>
+
+#ifndef _MSC_VER
+# include <sys/mman.h>
+#endif
+
+namespace rocksdb {
+
+void TerarkZipWarmUpPool::WarmUpBytes(const void* addr, size_t len) {
+  auto base = (const byte_t*)(uintptr_t(addr) & uintptr_t(~4095));
+  auto size = ((size_t(addr) & 4095) + len + 4095) & ~size_t(4095);
+#ifdef MADV_POPULATE_READ
+  // linux 5.14+, fault in all pages by one syscall
+  if (madvise((void*)base, size, MADV_POPULATE_READ) == 0) {
+    return;
+  }
+#endif
+#ifdef POSIX_MADV_WILLNEED
+  posix_madvise((void*)base, size, POSIX_MADV_WILLNEED);
+#endif
+  for (size_t i = 0; i < size; i += 4096) {
+    volatile byte_t unused = ((const volatile byte_t*)base)[i];
+    (void)unused;
+  }
+}
+
+TerarkZipWarmUpPool::TerarkZipWarmUpPool(size_t threadNum, size_t budgetBytes)
+  : stop_(false)
+  , budgetBytes_(budgetBytes)
+  , queuedBytes_(0)
+  , warmedBytes_(0)
+  , syncBytes_(0)
+  , skippedBytes_(0) {
+  threads_.reserve(threadNum);
+  for (size_t i = 0; i < threadNum; ++i) {
+    threads_.emplace_back(&TerarkZipWarmUpPool::WorkerProc, this);
+  }
+}
+
+TerarkZipWarmUpPool::~TerarkZipWarmUpPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    // all owners should have been canceled
+    assert(queue_.empty());
+    queue_.clear();
+  }
+  queueCond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void TerarkZipWarmUpPool::Submit(const void* owner,
+                                 const std::vector<fstring>& ranges) {
+  std::vector<fstring> syncRanges;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (fstring mem : ranges) {
+    size_t len = mem.size();
+    if (budgetBytes_) {
+      uint64_t queued = queuedBytes_.load(std::memory_order_relaxed);
+      size_t remain = queued < budgetBytes_ ? size_t(budgetBytes_ - queued) : 0;
+      if (len > remain) {
+        syncRanges.push_back(fstring(mem.data() + remain, len - remain));
+        len = remain;
+      }
+    }
+    queuedBytes_.fetch_add(len, std::memory_order_relaxed);
+    for (size_t pos = 0; pos < len; pos += kChunkBytes) {
+      size_t n = std::min<size_t>(size_t(kChunkBytes), len - pos);
+      queue_.push_back({owner, (const byte_t*)mem.data() + pos, n});
+    }
+  }
+  lock.unlock();
+  queueCond_.notify_all();
+  // the pool is full, fall back to synchronous warm up
+  for (fstring mem : syncRanges) {
+    WarmUpBytes(mem.data(), mem.size());
+    syncBytes_.fetch_add(mem.size(), std::memory_order_relaxed);
+  }
+}
+
+void TerarkZipWarmUpPool::Cancel(const void* owner) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto newEnd = std::remove_if(queue_.begin(), queue_.end(),
+    [owner](const Chunk& c) { return c.owner == owner; });
+  for (auto iter = newEnd; iter != queue_.end(); ++iter) {
+    queuedBytes_.fetch_sub(iter->len, std::memory_order_relaxed);
+    skippedBytes_.fetch_add(iter->len, std::memory_order_relaxed);
+  }
+  queue_.erase(newEnd, queue_.end());
+  doneCond_.wait(lock, [&]{ return running_.count(owner) == 0; });
+}
+
+size_t TerarkZipWarmUpPool::PendingTasks() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+void TerarkZipWarmUpPool::WorkerProc() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    queueCond_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+    if (stop_) {
+      break;
+    }
+    Chunk chunk = queue_.front();
+    queue_.pop_front();
+    running_[chunk.owner]++;
+    lock.unlock();
+    WarmUpBytes(chunk.addr, chunk.len);
+    warmedBytes_.fetch_add(chunk.len, std::memory_order_relaxed);
+    lock.lock();
+    queuedBytes_.fetch_sub(chunk.len, std::memory_order_relaxed);
+    auto iter = running_.find(chunk.owner);
+    if (--iter->second == 0) {
+      running_.erase(iter);
+      doneCond_.notify_all();
+    }
+  }
+}
+
+}  // namespace rocksdb
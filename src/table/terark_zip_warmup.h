@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef TERARK_ZIP_WARMUP_H_
+#define TERARK_ZIP_WARMUP_H_
+
+// std headers
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+// boost headers
+#include <boost/noncopyable.hpp>
+// terark headers
+#include <terark/fstring.hpp>
+#include <terark/stdtypes.hpp>
+
+namespace rocksdb {
+
+using terark::fstring;
+using terark::byte_t;
+
+/**
+ * populate page cache of mmaped memory by background threads, so a table
+ * is usable as soon as it is opened
+ *
+ * memory ranges are split into chunks, chunks of one table are populated
+ * in parallel, owner(the table reader) must call Cancel before the memory
+ * is unmapped
+ *
+ * bytes queued or being populated are bounded by the budget, they are
+ * credited back when chunks are done or canceled, ranges exceeding the
+ * budget are populated synchronously by Submit
+ */
+class TerarkZipWarmUpPool : boost::noncopyable {
+public:
+  /// @budgetBytes max bytes queued or running at a time, 0: no limit
+  TerarkZipWarmUpPool(size_t threadNum, size_t budgetBytes);
+  ~TerarkZipWarmUpPool();
+
+  /// populate [addr, addr+len) synchronously in calling thread
+  static void WarmUpBytes(const void* addr, size_t len);
+
+  void Submit(const void* owner, const std::vector<fstring>& ranges);
+
+  /// drop pending chunks of owner and wait for its running chunks
+  void Cancel(const void* owner);
+
+  /// bytes queued or running, not yet warmed
+  uint64_t QueuedBytes()  const { return queuedBytes_.load(std::memory_order_relaxed); }
+  uint64_t WarmedBytes()  const { return warmedBytes_.load(std::memory_order_relaxed); }
+  /// bytes warmed up synchronously because the budget is exhausted
+  uint64_t SyncBytes()    const { return syncBytes_.load(std::memory_order_relaxed); }
+  /// bytes dropped by Cancel
+  uint64_t SkippedBytes() const { return skippedBytes_.load(std::memory_order_relaxed); }
+  size_t   PendingTasks() const;
+
+private:
+  struct Chunk {
+    const void* owner;
+    const byte_t* addr;
+    size_t len;
+  };
+  void WorkerProc();
+
+  static const size_t kChunkBytes = 4 << 20;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queueCond_;
+  std::condition_variable doneCond_;
+  std::deque<Chunk> queue_;
+  std::unordered_map<const void*, size_t> running_; // owner -> chunks
+  std::vector<std::thread> threads_;
+  bool stop_;
+  size_t budgetBytes_;
+  std::atomic<uint64_t> queuedBytes_;
+  std::atomic<uint64_t> warmedBytes_;
+  std::atomic<uint64_t> syncBytes_;
+  std::atomic<uint64_t> skippedBytes_;
+};
+
+}  // namespace rocksdb
+
+#endif /* TERARK_ZIP_WARMUP_H_ */
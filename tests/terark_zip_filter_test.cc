@@ -0,0 +1,114 @@
+// project headers
+#include "terark_zip_filter.h"
+#include "terark_zip_test.h"
+// std headers
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+using namespace rocksdb;
+
+namespace {
+
+std::string MakeKey(const char* prefix, size_t i) {
+  char buf[32];
+  snprintf(buf, sizeof buf, "%s%08zu", prefix, i);
+  return buf;
+}
+
+void BuildFilter(size_t num, int bitsPerKey, valvec<byte_t>* output) {
+  std::vector<uint64_t> hashes;
+  for (size_t i = 0; i < num; ++i) {
+    hashes.push_back(TerarkZipBloomFilter::Hash(MakeKey("key", i)));
+  }
+  TerarkZipBloomFilter::Build(hashes.data(), num, bitsPerKey, output);
+}
+
+/// no false negative, return the false positive rate on keys not inserted
+double CheckFilter(size_t num, int bitsPerKey) {
+  valvec<byte_t> output;
+  BuildFilter(num, bitsPerKey, &output);
+  TerarkZipBloomFilter filter;
+  TZ_CHECK(filter.Init(fstring(output)));
+  TZ_CHECK(!filter.Empty());
+  for (size_t i = 0; i < num; ++i) {
+    TZ_CHECK(filter.MayMatch(TerarkZipBloomFilter::Hash(MakeKey("key", i))));
+  }
+  const size_t kProbes = 100000;
+  size_t falsePositive = 0;
+  for (size_t i = 0; i < kProbes; ++i) {
+    if (filter.MayMatch(TerarkZipBloomFilter::Hash(MakeKey("miss", i)))) {
+      ++falsePositive;
+    }
+  }
+  double rate = double(falsePositive) / kProbes;
+  fprintf(stderr, "  keys = %zu, bitsPerKey = %d, false positive = %.4f\n",
+          num, bitsPerKey, rate);
+  return rate;
+}
+
+void TestBloomFalsePositive() {
+  // blocked filter is a bit worse than the classic one, ~1% at 10 bits
+  double rate5 = CheckFilter(10000, 5);
+  double rate10 = CheckFilter(10000, 10);
+  double rate20 = CheckFilter(10000, 20);
+  TZ_CHECK(rate5 < 0.15);
+  TZ_CHECK(rate10 < 0.03);
+  TZ_CHECK(rate20 < 0.005);
+  TZ_CHECK(rate20 < rate10 && rate10 < rate5);
+  // one key in one block, and numProbes clamped to [1, 30]
+  CheckFilter(1, 10);
+  CheckFilter(1000, 1);
+  CheckFilter(1000, 100);
+}
+
+void TestBloomNoKey() {
+  valvec<byte_t> output;
+  BuildFilter(0, 10, &output);
+  TZ_CHECK_EQ(output.size(), TerarkZipBloomFilter::kBlockBytes + 8);
+  TerarkZipBloomFilter filter;
+  TZ_CHECK(filter.Init(fstring(output)));
+  TZ_CHECK(!filter.Empty());
+  for (size_t i = 0; i < 1000; ++i) {
+    TZ_CHECK(!filter.MayMatch(TerarkZipBloomFilter::Hash(MakeKey("key", i))));
+  }
+}
+
+void TestBloomBadMemory() {
+  valvec<byte_t> output;
+  BuildFilter(100, 10, &output);
+  fstring mem(output);
+  TerarkZipBloomFilter filter;
+  TZ_CHECK(filter.Init(mem));
+  // shorter than the trailer, or blocks not matching the trailer
+  TZ_CHECK(!filter.Init(mem.substr(0, 7)));
+  TZ_CHECK(filter.Empty());
+  TZ_CHECK(!filter.Init(mem.substr(mem.size() - 8)));
+  TZ_CHECK(!filter.Init(mem.substr(1)));
+  // numProbes or numBlocks out of range
+  uint32_t trailer[2];
+  memcpy(trailer, mem.data() + mem.size() - 8, sizeof trailer);
+  for (uint32_t numProbes : { 0, 31 }) {
+    valvec<byte_t> bad(output);
+    memcpy(bad.data() + bad.size() - 8, &numProbes, 4);
+    TZ_CHECK(!filter.Init(fstring(bad)));
+    TZ_CHECK(filter.Empty());
+  }
+  for (uint32_t numBlocks : { 0u, trailer[1] - 1, trailer[1] + 1 }) {
+    valvec<byte_t> bad(output);
+    memcpy(bad.data() + bad.size() - 4, &numBlocks, 4);
+    TZ_CHECK(!filter.Init(fstring(bad)));
+    TZ_CHECK(filter.Empty());
+  }
+}
+
+}  // namespace
+
+int main() {
+  TZ_RUN(TestBloomFalsePositive);
+  TZ_RUN(TestBloomNoKey);
+  TZ_RUN(TestBloomBadMemory);
+  fprintf(stderr, "all passed\n");
+  return 0;
+}
@@ -0,0 +1,365 @@
+// project headers
+#include "terark_zip_index.h"
+#include "terark_zip_table.h"
+#include "terark_zip_common.h"
+#include "terark_zip_test.h"
+// std headers
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <string.h>
+
+using namespace rocksdb;
+
+namespace {
+
+typedef std::vector<std::string> KeyVec;
+
+/// index built from sorted keys, then reloaded from its memory image as
+/// the table reader does
+struct LoadedIndex {
+  valvec<byte_t> mem;
+  unique_ptr<TerarkIndex> index;
+};
+
+void BuildIndex(const char* factoryName, const KeyVec& keys,
+                LoadedIndex* loaded) {
+  const TerarkIndex::Factory* factory = TerarkIndex::GetFactory(factoryName);
+  TZ_CHECK(factory != nullptr);
+  TerarkIndex::KeyStat ks;
+  TempFileDeleteOnClose tmpKeyFile;
+  tmpKeyFile.path = "/tmp/TerarkZipIndexTest-XXXXXX";
+  tmpKeyFile.open_temp();
+  for (const std::string& key : keys) {
+    tmpKeyFile.writer << fstring(key);
+    ks.minKeyLen = std::min(ks.minKeyLen, key.size());
+    ks.maxKeyLen = std::max(ks.maxKeyLen, key.size());
+    ks.sumKeyLen += key.size();
+  }
+  ks.numKeys = keys.size();
+  ks.minKey.assign((const byte_t*)keys.front().data(), keys.front().size());
+  ks.maxKey.assign((const byte_t*)keys.back().data(), keys.back().size());
+  tmpKeyFile.complete_write();
+  NativeDataInput<InputBuffer> reader(tmpKeyFile.input());
+  TerarkZipTableOptions tzo;
+  unique_ptr<TerarkIndex> built(factory->Build(reader, tzo, ks));
+  built->SaveMmap([loaded](const void* data, size_t size) {
+    loaded->mem.append((const byte_t*)data, size);
+  });
+  loaded->index = TerarkIndex::LoadMemory(fstring(loaded->mem));
+  TZ_CHECK(strcmp(loaded->index->Name(), built->Name()) == 0);
+}
+
+/// probes around every key: the key, its neighbours, shorter & longer keys
+KeyVec MakeProbes(const KeyVec& keys, size_t keyLen) {
+  KeyVec probes;
+  probes.push_back(std::string());
+  probes.push_back(std::string(keyLen, '\0'));
+  probes.push_back(std::string(keyLen, '\xff'));
+  probes.push_back(std::string(keyLen + 1, '\xff'));
+  for (const std::string& key : keys) {
+    probes.push_back(key);
+    probes.push_back(key + '\0');
+    probes.push_back(key + '\xff');
+    probes.push_back(key.substr(0, keyLen - 1));
+    for (int d : { -1, +1 }) {
+      std::string k = key;
+      k.back() = char(byte_t(k.back()) + d);
+      probes.push_back(k);
+    }
+  }
+  return probes;
+}
+
+/// compare Find, Seek, SeekMaxLE, Next & Prev with std algorithms on keys
+void CheckIndex(const TerarkIndex* index, const KeyVec& keys,
+                const KeyVec& probes) {
+  const size_t n = keys.size();
+  TZ_CHECK_EQ(index->NumKeys(), n);
+  unique_ptr<TerarkIndex::Iterator> iter(index->NewIterator());
+  // full scan in both directions, off the edges
+  TZ_CHECK(iter->SeekToFirst());
+  for (size_t i = 0; i < n; ++i) {
+    TZ_CHECK(iter->Valid());
+    TZ_CHECK_EQ(iter->id(), i);
+    TZ_CHECK_EQ(iter->DictRank(), i);
+    TZ_CHECK(iter->key() == fstring(keys[i]));
+    TZ_CHECK_EQ(index->Find(keys[i]), i);
+    TZ_CHECK_EQ(iter->Next(), i + 1 < n);
+  }
+  TZ_CHECK(!iter->Valid());
+  TZ_CHECK(iter->SeekToLast());
+  for (size_t i = n; i-- > 0; ) {
+    TZ_CHECK_EQ(iter->id(), i);
+    TZ_CHECK(iter->key() == fstring(keys[i]));
+    TZ_CHECK_EQ(iter->Prev(), i > 0);
+  }
+  TZ_CHECK(!iter->Valid());
+  for (const std::string& probe : probes) {
+    auto lb = std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+    auto ub = std::upper_bound(keys.begin(), keys.end(), probe) - keys.begin();
+    bool exists = size_t(lb) < n && keys[lb] == probe;
+    TZ_CHECK_EQ(index->Find(probe), exists ? size_t(lb) : size_t(-1));
+    // Seek: first key >= probe
+    TZ_CHECK_EQ(iter->Seek(probe), size_t(lb) < n);
+    if (size_t(lb) < n) {
+      TZ_CHECK_EQ(iter->id(), size_t(lb));
+      TZ_CHECK(iter->key() == fstring(keys[lb]));
+      TZ_CHECK_EQ(iter->Next(), size_t(lb) + 1 < n);
+      if (iter->Valid()) {
+        TZ_CHECK(iter->key() == fstring(keys[lb + 1]));
+      }
+      TZ_CHECK(iter->Seek(probe));
+      TZ_CHECK_EQ(iter->Prev(), lb > 0);
+      if (iter->Valid()) {
+        TZ_CHECK(iter->key() == fstring(keys[lb - 1]));
+      }
+    }
+    // SeekMaxLE: last key <= probe
+    TZ_CHECK_EQ(iter->SeekMaxLE(probe), ub > 0);
+    if (ub > 0) {
+      TZ_CHECK_EQ(iter->id(), size_t(ub - 1));
+      TZ_CHECK(iter->key() == fstring(keys[ub - 1]));
+    }
+  }
+  // FindBatch on sorted probes, duplicates included
+  KeyVec sorted = probes;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<fstring> batch(sorted.begin(), sorted.end());
+  std::vector<size_t> recIds(batch.size());
+  index->FindBatch(batch.size(), batch.data(), recIds.data());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    TZ_CHECK_EQ(recIds[i], index->Find(batch[i]));
+  }
+}
+
+std::string BigEndianKey(uint64_t val, size_t keyLen) {
+  std::string key(keyLen, '\0');
+  for (size_t i = keyLen; i > 0; ) {
+    key[--i] = char(byte_t(val));
+    val >>= 8;
+  }
+  return key;
+}
+
+void CheckKeys(const char* factoryName, KeyVec keys, size_t keyLen) {
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  LoadedIndex loaded;
+  BuildIndex(factoryName, keys, &loaded);
+  CheckIndex(loaded.index.get(), keys, MakeProbes(keys, keyLen));
+}
+
+void TestFixedLenKeySmall() {
+  CheckKeys("FixedLenKey", { "aaaa", "aaac", "abzz", std::string("b\0\0\0", 4),
+                             "zzzz", std::string(4, '\xff') }, 4);
+  // single key
+  CheckKeys("FixedLenKey", { "key1" }, 4);
+}
+
+void TestFixedLenKeyInterpolation() {
+  // more than 64 keys to go through the interpolation rounds
+  std::mt19937_64 rand(1);
+  KeyVec keys;
+  for (size_t i = 0; i < 2000; ++i) {
+    keys.push_back(BigEndianKey(rand(), 8) + BigEndianKey(rand(), 8));
+  }
+  CheckKeys("FixedLenKey", keys, 16);
+}
+
+void TestFixedLenKeySamePrefix64() {
+  // leading 8 bytes are all equal, interpolation is not selective
+  KeyVec keys;
+  for (size_t i = 0; i < 200; ++i) {
+    keys.push_back("samepref" + BigEndianKey(i * 3, 4));
+  }
+  CheckKeys("FixedLenKey", keys, 12);
+}
+
+/// mirror of TerarkIndexHeader + EliasFanoHeader in terark_zip_index.cc
+struct EliasFanoImageHeader {
+  uint8_t  magic_len;
+  char     magic[19];
+  char     class_name[60];
+  uint32_t reserved_80_4;
+  uint32_t header_size;
+  uint32_t version;
+  uint32_t reserved_92_4;
+  uint64_t file_size;
+  uint64_t reserved_102_24;
+  uint64_t keyLen;
+  uint64_t numKeys;
+  uint64_t minVal;
+  uint64_t maxDelta;
+  uint64_t lowBits;
+  uint64_t highLen;
+  uint64_t lowWords;
+  uint64_t highWords;
+  uint64_t select1Num;
+  uint64_t select0Num;
+};
+
+/// encode sorted values with the given lowBits, the same as the factory
+/// does with the lowBits it selects
+void EncodeEliasFano(const std::vector<uint64_t>& values, size_t keyLen,
+                     size_t lowBits, valvec<byte_t>* image) {
+  const size_t kSampleRate = 64;
+  size_t numKeys = values.size();
+  uint64_t minVal = values.front();
+  uint64_t maxDelta = values.back() - minVal;
+  size_t highLen = size_t(maxDelta >> lowBits) + numKeys + 1;
+  size_t lowWords = (numKeys * lowBits + 63) / 64 + 1;
+  size_t highWords = (highLen + 63) / 64 + 1;
+  size_t select1Num = (numKeys + kSampleRate - 1) / kSampleRate;
+  size_t select0Num = (highLen - numKeys + kSampleRate - 1) / kSampleRate;
+  size_t fileSize = sizeof(EliasFanoImageHeader) +
+    8 * (lowWords + highWords + select1Num + select0Num);
+  image->resize(fileSize, 0);
+  auto header = (EliasFanoImageHeader*)image->data();
+  header->magic_len = 18;
+  memcpy(header->magic, "EliasFanoUintIndex", 18);
+  strcpy(header->class_name, "EliasFanoUintIndex");
+  header->header_size = sizeof(EliasFanoImageHeader);
+  header->version = 1;
+  header->file_size = fileSize;
+  header->keyLen = keyLen;
+  header->numKeys = numKeys;
+  header->minVal = minVal;
+  header->maxDelta = maxDelta;
+  header->lowBits = lowBits;
+  header->highLen = highLen;
+  header->lowWords = lowWords;
+  header->highWords = highWords;
+  header->select1Num = select1Num;
+  header->select0Num = select0Num;
+  auto low = (uint64_t*)(header + 1);
+  auto high = low + lowWords;
+  auto select1 = high + highWords;
+  auto select0 = select1 + select1Num;
+  for (size_t i = 0; i < numKeys; ++i) {
+    uint64_t delta = values[i] - minVal;
+    if (lowBits) {
+      uint64_t x = delta & ((uint64_t(1) << lowBits) - 1);
+      size_t pos = i * lowBits;
+      low[pos / 64] |= x << (pos % 64);
+      if (pos % 64 + lowBits > 64) {
+        low[pos / 64 + 1] |= x >> (64 - pos % 64);
+      }
+    }
+    size_t pos = size_t(delta >> lowBits) + i;
+    high[pos / 64] |= uint64_t(1) << (pos % 64);
+    if (i % kSampleRate == 0) {
+      select1[i / kSampleRate] = pos;
+    }
+  }
+  for (size_t pos = 0, j = 0; pos < highLen; ++pos) {
+    if (!((high[pos / 64] >> (pos % 64)) & 1)) {
+      if (j % kSampleRate == 0) {
+        select0[j / kSampleRate] = pos;
+      }
+      ++j;
+    }
+  }
+}
+
+KeyVec ValuesToKeys(std::vector<uint64_t>* values, size_t keyLen) {
+  std::sort(values->begin(), values->end());
+  values->erase(std::unique(values->begin(), values->end()), values->end());
+  KeyVec keys;
+  for (uint64_t val : *values) {
+    keys.push_back(BigEndianKey(val, keyLen));
+  }
+  return keys;
+}
+
+/// build by the factory and check, return the lowBits it selected
+size_t CheckEliasFano(std::vector<uint64_t> values, size_t keyLen) {
+  KeyVec keys = ValuesToKeys(&values, keyLen);
+  LoadedIndex loaded;
+  BuildIndex("EliasFanoUint", keys, &loaded);
+  auto header = (const EliasFanoImageHeader*)loaded.mem.data();
+  TZ_CHECK(strcmp(header->class_name, "EliasFanoUintIndex") == 0);
+  // the mirror encoder must produce the same image, it is used below to
+  // cover the lowBits the factory never selects
+  valvec<byte_t> image;
+  EncodeEliasFano(values, keyLen, size_t(header->lowBits), &image);
+  TZ_CHECK(fstring(image) == fstring(loaded.mem));
+  CheckIndex(loaded.index.get(), keys, MakeProbes(keys, keyLen));
+  return size_t(header->lowBits);
+}
+
+void TestEliasFanoDense() {
+  // consecutive values, maxDelta / numKeys <= 1
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < 300; ++i) {
+    values.push_back(1000 + i);
+  }
+  TZ_CHECK_EQ(CheckEliasFano(values, 2), 0u);
+  TZ_CHECK_EQ(CheckEliasFano({ 7 }, 8), 0u); // single key
+}
+
+void TestEliasFanoEmptyBuckets() {
+  // two clusters far away, buckets between them are empty, and more than
+  // 64 zeros to go through select0 samples
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < 100; ++i) {
+    values.push_back(i);
+    values.push_back(1000000000 + i * 2);
+  }
+  size_t lowBits = CheckEliasFano(values, 4);
+  std::vector<uint64_t> highs;
+  for (uint64_t val : values) {
+    highs.push_back(val >> lowBits);
+  }
+  std::sort(highs.begin(), highs.end());
+  size_t used = std::unique(highs.begin(), highs.end()) - highs.begin();
+  size_t buckets = size_t(highs.back() - highs.front()) + 1;
+  TZ_CHECK(used + 64 < buckets);
+}
+
+void TestEliasFanoShortKey() {
+  // keyLen 3, probes shorter and longer than keyLen are padded
+  std::mt19937_64 rand(2);
+  std::vector<uint64_t> values;
+  for (size_t i = 0; i < 1000; ++i) {
+    values.push_back(rand() & 0xFFFFFF);
+  }
+  values.push_back(0xFFFFFF); // longer probe of max key has no successor
+  CheckEliasFano(values, 3);
+}
+
+void TestEliasFanoMaxLowBits() {
+  // widest range, the factory never selects more than lowBits 62
+  TZ_CHECK_EQ(CheckEliasFano({ 0, ~uint64_t(0) }, 8), 62u);
+  TZ_CHECK_EQ(CheckEliasFano({ 0, 1, uint64_t(1) << 63, ~uint64_t(0) }, 8),
+              61u);
+}
+
+void TestEliasFanoLowBits63() {
+  // lowBits 63: low parts cross word boundaries, high parts are 0 or 1
+  std::vector<uint64_t> values = {
+    0, 5, (uint64_t(1) << 63) - 1, uint64_t(1) << 63,
+    ~uint64_t(0) - 1, ~uint64_t(0),
+  };
+  KeyVec keys = ValuesToKeys(&values, 8);
+  valvec<byte_t> image;
+  EncodeEliasFano(values, 8, 63, &image);
+  unique_ptr<TerarkIndex> index = TerarkIndex::LoadMemory(fstring(image));
+  CheckIndex(index.get(), keys, MakeProbes(keys, 8));
+}
+
+}  // namespace
+
+int main() {
+  TZ_RUN(TestFixedLenKeySmall);
+  TZ_RUN(TestFixedLenKeyInterpolation);
+  TZ_RUN(TestFixedLenKeySamePrefix64);
+  TZ_RUN(TestEliasFanoDense);
+  TZ_RUN(TestEliasFanoEmptyBuckets);
+  TZ_RUN(TestEliasFanoShortKey);
+  TZ_RUN(TestEliasFanoMaxLowBits);
+  TZ_RUN(TestEliasFanoLowBits63);
+  fprintf(stderr, "all passed\n");
+  return 0;
+}
@@ -0,0 +1,137 @@
+// project headers
+#include "terark_zip_internal.h"
+#include "terark_zip_test.h"
+// std headers
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <string.h>
+
+using namespace rocksdb;
+
+namespace {
+
+typedef std::vector<uint64_t> SeqVec;
+
+const uint64_t kUnused = TerarkZipSeqColumn::kUnused;
+
+/// seq read back for seqs[i], kUnused is stored as minSeq
+SeqVec Expected(const SeqVec& seqs) {
+  uint64_t minSeq = kUnused;
+  for (uint64_t seq : seqs) {
+    if (kUnused != seq) {
+      minSeq = std::min(minSeq, seq);
+    }
+  }
+  if (kUnused == minSeq) {
+    minSeq = 0;
+  }
+  SeqVec expected;
+  for (uint64_t seq : seqs) {
+    expected.push_back(kUnused == seq ? minSeq : seq);
+  }
+  return expected;
+}
+
+/// build all parts into one output, then read them back in turn as the
+/// table reader does, return the bits of each part
+std::vector<size_t> CheckParts(const std::vector<SeqVec>& parts) {
+  valvec<byte_t> output;
+  for (const SeqVec& seqs : parts) {
+    TerarkZipSeqColumn::Build(seqs.data(), seqs.size(), &output);
+  }
+  std::vector<size_t> bits;
+  fstring mem(output);
+  for (const SeqVec& seqs : parts) {
+    TerarkZipSeqColumn column;
+    size_t used = column.Init(mem, seqs.size());
+    TZ_CHECK(used > 0);
+    TZ_CHECK(used <= size_t(mem.size()));
+    TZ_CHECK_EQ(used % 8, 0u);
+    TZ_CHECK(!column.Empty());
+    SeqVec expected = Expected(seqs);
+    for (size_t i = 0; i < seqs.size(); ++i) {
+      TZ_CHECK_EQ(column.get(i), expected[i]);
+    }
+    bits.push_back(column.bits_);
+    mem = mem.substr(used);
+  }
+  TZ_CHECK_EQ(mem.size(), 0);
+  return bits;
+}
+
+void TestSeqColumnParts() {
+  std::mt19937_64 rand(3);
+  std::vector<SeqVec> parts(5);
+  for (size_t i = 0; i < 1000; ++i) {
+    parts[0].push_back(1000000 + rand() % 5000);
+  }
+  parts[1] = { 0, 7, 14 };
+  parts[2].push_back(42);
+  for (size_t i = 0; i < 777; ++i) {
+    parts[3].push_back(i % 3 ? rand() % 100000 : kUnused);
+  }
+  for (size_t i = 0; i < 65; ++i) {
+    parts[4].push_back(rand() & ((uint64_t(1) << 17) - 1));
+  }
+  CheckParts(parts);
+}
+
+void TestSeqColumnZeroBits() {
+  // all kUnused, all equal, and no record at all need no data bits
+  std::vector<SeqVec> parts = {
+    SeqVec(100, kUnused),
+    SeqVec(100, 123456789),
+    { kUnused, 5, kUnused, 5 },
+    SeqVec(),
+  };
+  for (size_t bits : CheckParts(parts)) {
+    TZ_CHECK_EQ(bits, 0u);
+  }
+}
+
+void TestSeqColumnWide() {
+  // sequence number has 56 bits, deltas cross the 8 bytes read by get()
+  const uint64_t kMaxSeq = (uint64_t(1) << 56) - 1;
+  std::mt19937_64 rand(4);
+  SeqVec seqs = { 0, kMaxSeq, kUnused };
+  for (size_t i = 0; i < 500; ++i) {
+    seqs.push_back(rand() & kMaxSeq);
+  }
+  SeqVec high = { kMaxSeq, kMaxSeq - 1, uint64_t(1) << 55 };
+  std::vector<size_t> bits = CheckParts({ seqs, high });
+  TZ_CHECK_EQ(bits[0], 56u);
+  TZ_CHECK_EQ(bits[1], 55u);
+}
+
+void TestSeqColumnBad() {
+  SeqVec seqs = { 1, 2, 3, 100 };
+  valvec<byte_t> output;
+  TerarkZipSeqColumn::Build(seqs.data(), seqs.size(), &output);
+  fstring mem(output);
+  TerarkZipSeqColumn column;
+  TZ_CHECK(column.Init(mem, seqs.size()) == size_t(mem.size()));
+  // truncated header or data
+  TZ_CHECK_EQ(column.Init(mem.substr(0, 16), seqs.size()), 0u);
+  TZ_CHECK(column.Empty());
+  TZ_CHECK_EQ(column.Init(mem.substr(0, mem.size() - 8), seqs.size()), 0u);
+  // record number does not match the part size
+  TZ_CHECK_EQ(column.Init(mem, 1000), 0u);
+  // bits out of range
+  valvec<byte_t> bad(output);
+  uint64_t bits = 57;
+  memcpy(bad.data() + 16, &bits, 8);
+  TZ_CHECK_EQ(column.Init(fstring(bad), seqs.size()), 0u);
+  TZ_CHECK(column.Empty());
+}
+
+}  // namespace
+
+int main() {
+  TZ_RUN(TestSeqColumnParts);
+  TZ_RUN(TestSeqColumnZeroBits);
+  TZ_RUN(TestSeqColumnWide);
+  TZ_RUN(TestSeqColumnBad);
+  fprintf(stderr, "all passed\n");
+  return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef TERARK_ZIP_TEST_H_
+#define TERARK_ZIP_TEST_H_
+
+// std headers
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * minimal checks for the unit tests in this directory, they are built by
+ * `make test` and linked to the debug library, a failed check aborts
+ */
+#define TZ_CHECK(cond)                                                  \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n",                      \
+              __FILE__, __LINE__, #cond);                               \
+      abort();                                                          \
+    }                                                                   \
+  } while (0)
+
+#define TZ_CHECK_EQ(x, y) TZ_CHECK((x) == (y))
+
+#define TZ_RUN(test)                                                    \
+  do {                                                                  \
+    fprintf(stderr, "%s ...\n", #test);                                 \
+    test();                                                             \
+  } while (0)
+
+#endif /* TERARK_ZIP_TEST_H_ */